@@ -11,6 +11,7 @@ template<> struct Traits<CPU>: public Traits<Build>
     static const unsigned int ENDIANESS         = LITTLE;
     static const unsigned int WORD_SIZE         = 32;
     static const unsigned int CLOCK             = (MODEL == LM3S811) ? 50000000 : (MODEL == Zynq) ? 666666687 : (MODEL == Realview_PBX) ? 100000000 : 1400000000L;
+    static const unsigned int CACHE_LINE_SIZE   = 32;
     static const bool unaligned_memory_access   = false;
 };
 
@@ -287,6 +287,8 @@ public:
         void save() volatile __attribute__ ((naked));
         void load() const volatile __attribute__ ((naked));
 
+        Log_Addr ip() const { return _eip; }
+
         friend OStream & operator<<(OStream & os, const Context & c) {
             os << hex
                << "{flags=" << c._eflags
@@ -353,19 +355,20 @@ public:
     static volatile unsigned int id();
     static unsigned int cores() { return multicore ? _cores : 1; }
 
-    static Hertz clock() { return _cpu_current_clock; }
+    // Clock modulation is per core, so each CPU has a current clock of its own
+    static Hertz clock() { return _cpu_current_clock[id()]; }
     static void clock(Hertz frequency) {
         Reg64 clock = frequency;
         // unsigned int dc;
         if(clock <= (_cpu_clock * 1875ULL / 10000ULL)) {
             // dc = 0b10011;   // minimum duty cycle of 12.5 %
-            _cpu_current_clock = _cpu_clock * 1875ULL / 10000ULL;
+            _cpu_current_clock[id()] = _cpu_clock * 1875ULL / 10000ULL;
         } else if(clock >= (_cpu_clock * 9375ULL / 10000ULL)) {
             // dc = 0b01001;   // disable duty cycling and operate at full speed
-            _cpu_current_clock = _cpu_clock;
+            _cpu_current_clock[id()] = _cpu_clock;
         } else {
             // dc = 0b10001 | ((clock * 10000ULL / _cpu_clock + 625ULL) / 625ULL); // dividing by 625 instead of 1250 eliminates the shift left
-            _cpu_current_clock = _cpu_clock * ((clock * 10000ULL / _cpu_clock + 625ULL) / 625ULL) * 625ULL / 10000ULL;
+            _cpu_current_clock[id()] = _cpu_clock * ((clock * 10000ULL / _cpu_clock + 625ULL) / 625ULL) * 625ULL / 10000ULL;
             // The ((clock * 10000 / _cpu_clock + 625) / 625) returns the factor, the step is 625/10000
             // thus, max_clock * factor * step = final clock
         }
@@ -605,7 +608,7 @@ private:
 private:
     static volatile unsigned int _cores;
     static Hertz _cpu_clock;
-    static Hertz _cpu_current_clock;
+    static Hertz _cpu_current_clock[Traits<Build>::CPUS];
     static Hertz _bus_clock;
 };
 
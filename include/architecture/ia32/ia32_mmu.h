@@ -5,6 +5,7 @@
 
 #include <architecture/mmu.h>
 #include <system/memory_map.h>
+#include <utility/buddy.h>
 
 __BEGIN_SYS
 
@@ -14,7 +15,6 @@ class MMU: public MMU_Common<10, 10, 12>
     friend class Setup;
 
 private:
-    typedef Grouping_List<Frame> List;
     typedef MMU_Common<10, 10, 12> Common;
 
     static const bool colorful = Traits<MMU>::colorful;
@@ -370,13 +370,16 @@ public:
 public:
     MMU() {}
 
+    // Free frames are kept by a buddy allocator per color, in blocks of up to 2^(ORDERS - 1) frames (see Buddy)
+    static const unsigned int ORDERS = 19;
+
     static Phy_Addr alloc(unsigned long frames = 1, Color color = WHITE) {
         Phy_Addr phy(false);
 
         if(frames) {
-            List::Element * e = _free[color].search_decrementing(frames);
-            if(e) {
-                phy = e->object() + e->size();
+            Log_Addr log = _free[color].alloc(frames);
+            if(log) {
+                phy = log2phy(log);
                 db<MMU>(TRC) << "MMU::alloc(frames=" << frames << ",color=" << color << ") => " << phy << endl;
             } else
                 if(colorful)
@@ -401,11 +404,8 @@ public:
 
         db<MMU>(TRC) << "MMU::free(frame=" << frame << ",color=" << color << ",n=" << n << ")" << endl;
 
-        if(frame && n) {
-            List::Element * e = new (phy2log(frame)) List::Element(frame, n);
-            List::Element * m1, * m2;
-            _free[color].insert_merging(e, &m1, &m2);
-        }
+        if(frame && n)
+            _free[color].free(phy2log(frame), n);
     }
 
     static void white_free(Phy_Addr frame, unsigned long n) {
@@ -414,14 +414,18 @@ public:
 
         db<MMU>(TRC) << "MMU::free(frame=" << frame << ",color=" << WHITE << ",n=" << n << ")" << endl;
 
-        if(frame && n) {
-            List::Element * e = new (phy2log(frame)) List::Element(frame, n);
-            List::Element * m1, * m2;
-            _free[WHITE].insert_merging(e, &m1, &m2);
-        }
+        if(frame && n)
+            _free[WHITE].free(phy2log(frame), n);
     }
 
-    static unsigned long allocable(Color color = WHITE) { return _free[color].head() ? _free[color].head()->size() : 0; }
+    // The largest run that can be allocated at once
+    static unsigned long allocable(Color color = WHITE) { return _free[color].largest(); }
+
+    // Statistics: free frames, free blocks of 2^order frames, and the percentage of the free frames that lie in blocks
+    // too small for a run of 2^order frames (0 means all of them are usable for it)
+    static unsigned long free_frames(Color color = WHITE) { return _free[color].grouped_size(); }
+    static unsigned long free_blocks(unsigned int order, Color color = WHITE) { return _free[color].blocks(order); }
+    static unsigned int fragmentation(unsigned int order, Color color = WHITE) { return _free[color].fragmentation(order); }
 
     static Page_Directory * volatile current() { return static_cast<Page_Directory * volatile>(pd()); }
 
@@ -469,6 +473,8 @@ private:
     static void init();
 
 private:
+    typedef Buddy<PT_SHIFT, ORDERS> List;
+
     static List _free[colorful * COLORS + 1]; // +1 for WHITE
     static Page_Directory * _master;
 };
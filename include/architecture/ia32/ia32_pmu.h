@@ -94,6 +94,9 @@ public:
 public:
     Intel_PMU_V1() {}
 
+    // Unsupported events must never reach config()
+    static bool supported(Event event) { return (event < EVENTS) && (_events[event] != UNSUPORTED_EVENT); }
+
     static void config(Channel channel, Event event, Flags flags = NONE) {
         assert((channel < CHANNELS) && (event < EVENTS) && _events[event] != UNSUPORTED_EVENT);
         db<PMU>(TRC) << "PMU::config(c=" << channel << ",e=" << event << ",f=" << flags << ")" << endl;
@@ -631,6 +634,9 @@ public:
 public:
     Intel_Sandy_Bridge_PMU() {}
 
+    // Unsupported events must never reach config()
+    static bool supported(Event event) { return (event < EVENTS) && (_events[event] != UNSUPORTED_EVENT); }
+
     static bool config(Channel channel, Event event, Flags flags = NONE) {
         assert((channel < CHANNELS) && (event < EVENTS) && _events[event] != UNSUPORTED_EVENT);
         db<PMU>(TRC) << "PMU::config(c=" << channel << ",e=" << event << ",f=" << flags << ")" << endl;
@@ -737,14 +743,79 @@ public:
     using Engine::CHANNELS;
     using Engine::FIXED;
     using Engine::EVENTS;
+    using Engine::supported;
+
+    static const Event UNUSED = UNSUPORTED_EVENT;
+    static const unsigned int MULTIPLEXED = Traits<PMU>::MULTIPLEXED;
+
+    // A thread's view of the counters, saved and restored at each context switch (see Thread::dispatch()).
+    // Threads that do not choose their events count the fixed ones, plus branch mispredictions and last-level cache misses
+    // on the first two programmable channels, which feed the CPU selection heuristics in Thread.
+    // Besides those, a thread can count up to MULTIPLEXED more events, which are rotated in groups over the programmable
+    // channels it leaves unused, one group per time slice (see rotate()), and whose counts are then scaled by the fraction
+    // of the thread's running time each of them was actually counted (see estimate()).
+    struct Context {
+        Context(const Event * events = 0, const Event * mux = 0);
+
+        Event event[CHANNELS];
+        Count count[CHANNELS];
+
+        unsigned int multiplexed;               // number of multiplexed events
+        unsigned int first;                     // first event of the current group
+        unsigned int group;                     // number of events in the current group
+        Count since;                            // time stamp of the last (re)load of the current group
+        Count running;                          // time the thread has run with this context loaded (TSC ticks)
+        Channel mux_channel[CHANNELS];          // channel of each event in the current group
+        Event mux_event[MULTIPLEXED];
+        Count mux_count[MULTIPLEXED];
+        Count enabled[MULTIPLEXED];             // time each multiplexed event has been counted (TSC ticks)
+    };
 
 public:
     PMU() {}
 
+    static void save(Context * ctx);
+    static void load(Context * ctx);
+
+    static Count count(const Context * ctx, Channel channel, bool loaded = false) {
+        assert(channel < CHANNELS);
+        if(ctx->event[channel] == UNUSED)
+            return 0;
+        return ctx->count[channel] + ((loaded && !(_armed[CPU::id()] & (1 << channel))) ? read(channel) : 0);
+    }
+
+    static void rotate(Context * ctx);
+
+    // The count of the i-th multiplexed event, as if it had been counted all along, up to the last rotation or context switch
+    static Count estimate(const Context * ctx, unsigned int i) {
+        if((i >= ctx->multiplexed) || !ctx->enabled[i])
+            return 0;
+        if(ctx->enabled[i] == ctx->running)
+            return ctx->mux_count[i];
+        return (ctx->mux_count[i] * ((ctx->running << 10) / ctx->enabled[i])) >> 10; // 10 fractional bits are plenty here
+    }
+
+    // Sampling: an armed (programmable) channel counts its event on every CPU, regardless of the running thread,
+    // and interrupts each time it counts another period of events. Other CPUs arm it at their next dispatch.
+    static bool arm(Channel channel, Event event, Count period, Overflow_Handler * handler);
+    static void disarm(Channel channel);
+
 private:
+    static void fold(Context * ctx);
+    static void program(Channel channel, Event event);
+    static void sample();
+
     static void int_handler(Interrupt_Id i);
 
     static void init();
+
+private:
+    static Event _programmed[Traits<Machine>::CPUS][CHANNELS];
+    static Event _sampled[CHANNELS];
+    static Count _period[CHANNELS];
+    static Overflow_Handler * _overflow;
+    static volatile unsigned int _sampling; // channels armed system-wide (bitmap)
+    static unsigned int _armed[Traits<Machine>::CPUS]; // channels armed on each CPU (bitmap)
 };
 
 __END_SYS
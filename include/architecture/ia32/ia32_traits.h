@@ -12,6 +12,7 @@ template<> struct Traits<CPU>: public Traits<Build>
     static const unsigned int ENDIANESS         = LITTLE;
     static const unsigned int WORD_SIZE         = 32;
     static const unsigned int CLOCK             = 2000000000;
+    static const unsigned int CACHE_LINE_SIZE   = 64;
     static const bool unaligned_memory_access   = true;
 };
 
@@ -36,6 +37,7 @@ template<> struct Traits<PMU>: public Traits<Build>
     static const bool enabled = true;
     enum { V1, V2, V3, DUO, MICRO, ATOM, SANDY_BRIDGE };
     static const unsigned int VERSION = SANDY_BRIDGE;
+    static const unsigned int MULTIPLEXED = 16; // events each thread can count beyond the channels, by time multiplexing
 };
 
 __END_SYS
@@ -16,7 +16,7 @@ public:
 public:
     TSC() {}
 
-    static Hertz frequency() { return CPU::clock(); }
+    static Hertz frequency() { return CPU::max_clock(); } // the TSC ticks at the nominal clock whatever the current one is
     static PPB accuracy() { return 50; }
 
     static Time_Stamp time_stamp() {
@@ -19,6 +19,15 @@ public:
         INT
     };
 
+    // Called, with interrupts disabled, whenever an armed channel overflows, with the address of the interrupted instruction
+    typedef void (Overflow_Handler)(Channel channel, void * ip);
+
+    // A thread's view of the counters: the events it counts on each channel and what it has counted so far
+    // (saved and restored at each context switch; see Thread::dispatch())
+    struct Context {
+        Context(const Event * events = 0, const Event * mux = 0) {}
+    };
+
 protected:
     static const unsigned int CHANNELS = 0;
     static const unsigned int FIXED = 0;
@@ -35,6 +44,15 @@ public:
     static void start(Channel channel) {}
     static void stop(Channel channel) {}
     static void reset(Channel channel) {}
+
+    static void save(Context * ctx) {}
+    static void load(Context * ctx) {}
+    static Count count(const Context * ctx, Channel channel, bool loaded = false) { return 0; }
+    static void rotate(Context * ctx) {}
+    static Count estimate(const Context * ctx, unsigned int i) { return 0; }
+
+    static bool arm(Channel channel, Event event, Count period, Overflow_Handler * handler) { return false; }
+    static void disarm(Channel channel) {}
 };
 
 #ifndef __PMU_H
@@ -0,0 +1,200 @@
+// EPOS Coroutine Declarations
+
+#ifndef __coroutine_h
+#define __coroutine_h
+
+#include <architecture.h>
+#include <utility/list.h>
+#include <utility/spin.h>
+#include <process.h>
+#include <synchronizer.h>
+
+__BEGIN_SYS
+
+// Stackless coroutines: run() is written between CO_BEGIN and CO_END and returns at each suspension point (CO_YIELD,
+// CO_AWAIT, CO_DELAY, CO_WAIT_NEXT), to be reentered right after it when the coroutine is resumed. Nothing is kept on a
+// stack in between, so whatever must survive a suspension has to be a member (locals do not), and suspension points can
+// only appear in run() itself. Each CPU multiplexes its coroutines on a single thread, its run loop, created at the first
+// start() on it. Run loops do not keep EPOS running: threads must join() the coroutines they depend on.
+#define CO_BEGIN            switch(_line) { case 0:
+#define CO_END              } end(); return
+#define CO_YIELD            do { _line = __LINE__; yield(); return; case __LINE__:; } while(0)
+#define CO_AWAIT(a)         do { _line = __LINE__; case __LINE__: if(!(a).await(this)) return; } while(0)
+#define CO_DELAY(t)         do { _line = __LINE__; delay(t); return; case __LINE__:; } while(0)
+#define CO_WAIT_NEXT(p)     do { _line = __LINE__; wait_next(p); return; case __LINE__:; } while(0)
+
+class Coroutine
+{
+public:
+    typedef long Tick; // of RESOLUTION us
+    typedef List_Elements::Doubly_Linked_Ordered<Coroutine, Tick> Element;
+    typedef List<Coroutine, Element> Queue;
+
+    static const unsigned int CPUS = Traits<Machine>::CPUS;
+    static const unsigned int RESOLUTION = Traits<Coroutine>::RESOLUTION;
+    static const unsigned int ANY = -1U;
+
+    enum State {
+        READY,
+        RUNNING,
+        WAITING,
+        SLEEPING,
+        FINISHED
+    };
+
+    // Awaitables park coroutines in queues of their own and hand them back to their run loops when they can go on, so
+    // they can be signaled from threads and interrupt handlers as well
+    class Awaitable
+    {
+    protected:
+        Awaitable() {}
+
+        bool lock() {
+            bool disabled = CPU::int_disabled();
+            CPU::int_disable();
+            _lock.acquire();
+            return disabled;
+        }
+
+        void unlock(bool disabled) {
+            _lock.release();
+            if(!disabled)
+                CPU::int_enable();
+        }
+
+        bool park(Coroutine * c) { // with the lock held
+            if(c->_signaled) {
+                c->_signaled = false;
+                return true;
+            }
+            c->_state = WAITING;
+            _waiting.insert(&c->_link);
+            return false;
+        }
+
+        Coroutine * unpark() { // with the lock held
+            Coroutine * c = _waiting.empty() ? 0 : _waiting.remove()->object();
+            if(c)
+                c->_signaled = true;
+            return c;
+        }
+
+    protected:
+        Simple_Spin _lock;
+        Queue _waiting;
+    };
+
+    class Semaphore: public Awaitable
+    {
+    public:
+        Semaphore(long v = 1): _value(v) {}
+
+        bool await(Coroutine * c); // p()
+        void v();
+
+    private:
+        volatile long _value;
+    };
+
+    class Condition: public Awaitable
+    {
+    public:
+        Condition() {}
+
+        bool await(Coroutine * c); // wait()
+        void signal();
+        void broadcast();
+    };
+
+public:
+    Coroutine(): _line(0), _state(FINISHED), _cpu(0), _signaled(false), _ended(false), _wake(0), _link(this) {}
+    virtual ~Coroutine() {} // only after having finished (see join())
+
+    State state() const { return _state; }
+
+    bool start(unsigned int cpu = ANY);
+    void join();
+
+    static unsigned long count(unsigned int cpu) { return _loop[cpu].count; }
+
+protected:
+    virtual void run() = 0;
+
+    // Suspension points (see the CO_* macros)
+    void yield() { _state = READY; }
+    void delay(const Microsecond & time);
+    void wait_next(const Microsecond & period);
+    void end() { _ended = true; }
+
+private:
+    void ready();
+
+    static int loop(unsigned int cpu);
+
+    static Tick now() { return TSC::time_stamp() / (TSC::frequency() / 1000000) / RESOLUTION; }
+    static Tick ticks(const Microsecond & time) { return (time + RESOLUTION - 1) / RESOLUTION; }
+
+protected:
+    int _line; // where run() resumes
+
+private:
+    volatile State _state;
+    unsigned int _cpu;
+    volatile bool _signaled;
+    bool _ended;
+    Tick _wake;
+    Element _link;
+
+    // A CPU's run loop, locked like Awaitables, on cache lines of its own
+    struct alignas(Traits<CPU>::CACHE_LINE_SIZE) Loop {
+        Loop(): running(0), count(0), idle(false), spawned(false), wakeup(0) {}
+
+        bool lock() {
+            bool disabled = CPU::int_disabled();
+            CPU::int_disable();
+            spin.acquire();
+            return disabled;
+        }
+
+        void unlock(bool disabled) {
+            spin.release();
+            if(!disabled)
+                CPU::int_enable();
+        }
+
+        Simple_Spin spin;
+        Queue ready;
+        Timing_Wheel<Coroutine, Tick, Element> sleeping;
+        Coroutine * volatile running;
+        volatile unsigned long count;
+        volatile bool idle;
+        volatile bool spawned;
+        _SYS::Semaphore wakeup;
+    };
+
+    // Threads join under the lock coroutines finish on, so no end is missed and finished coroutines are never touched again
+    class Joining: protected Synchronizer_Common
+    {
+    public:
+        void wait(Coroutine * c) {
+            begin_atomic();
+            while(c->_state != FINISHED)
+                sleep();
+            end_atomic();
+        }
+
+        void signal(Coroutine * c) {
+            begin_atomic();
+            c->_state = FINISHED;
+            wakeup_all();
+            end_atomic();
+        }
+    };
+
+    static Loop _loop[CPUS];
+    static Joining _joining;
+};
+
+__END_SYS
+
+#endif
@@ -0,0 +1,144 @@
+// EPOS Task Executor Declarations
+
+#ifndef __executor_h
+#define __executor_h
+
+#include <architecture.h>
+#include <utility/spin.h>
+#include <process.h>
+#include <synchronizer.h>
+
+__BEGIN_SYS
+
+// Runs short computations on a fixed pool of WORKERS worker threads, created at the first submission, instead of on
+// threads of their own. Each worker keeps the work it submits in a deque of its own (Chase-Lev), from which it takes the
+// newest and other workers steal the oldest; work submitted by other threads goes to a per-CPU inbox, served in order.
+// Submissions that find no room run right away on the submitting thread. Waiting for a future helps running pending work
+// before blocking. Workers do not keep EPOS running, so work whose futures nobody waits for might not run at all.
+class Executor
+{
+public:
+    typedef int (Function)(void *);
+
+    static const unsigned int WORKERS = Traits<Executor>::enabled ? Traits<Executor>::WORKERS_PER_CPU * Traits<Machine>::CPUS : 1;
+    static const unsigned int DEQUE_SIZE = Traits<Executor>::DEQUE_SIZE; // a power of 2
+
+    class Future
+    {
+        friend class Executor;
+
+    public:
+        Future(): _function(0), _argument(0), _result(0), _done(true) {}
+        ~Future() { wait(); } // work must not outlive its future
+
+        volatile bool done() const { return _done; }
+        int wait() { return Executor::wait(this); }
+
+    private:
+        Function * _function;
+        void * _argument;
+        volatile int _result;
+        volatile bool _done;
+    };
+
+private:
+    // Chase-Lev work-stealing deque, of fixed size: the owner pushes and pops at the bottom, thieves steal from the top.
+    // The owner claims the bottom with an atomic decrement, which also orders its pop against concurrent steals.
+    class Deque
+    {
+    public:
+        Deque(): _top(0), _bottom(0) {}
+
+        bool push(Future * f) {
+            long b = _bottom;
+            if(b - _top >= long(DEQUE_SIZE))
+                return false;
+            _items[b & (DEQUE_SIZE - 1)] = f;
+            _bottom = b + 1;
+            return true;
+        }
+
+        Future * pop() {
+            long b = CPU::fdec(_bottom) - 1;
+            long t = _top;
+            if(b - t < 0) {
+                _bottom = b + 1;
+                return 0;
+            }
+            Future * f = _items[b & (DEQUE_SIZE - 1)];
+            if(b - t > 0)
+                return f;
+            if(CPU::cas(_top, t, t + 1) != t) // the last one, which a thief might be taking too
+                f = 0;
+            _bottom = b + 1;
+            return f;
+        }
+
+        Future * steal() {
+            long t = _top;
+            long b = _bottom;
+            if(b - t <= 0)
+                return 0;
+            Future * f = _items[t & (DEQUE_SIZE - 1)];
+            if(CPU::cas(_top, t, t + 1) != t)
+                return 0;
+            return f;
+        }
+
+    private:
+        volatile long _top;
+        volatile long _bottom;
+        Future * volatile _items[DEQUE_SIZE];
+    };
+
+    // Futures complete under the lock they are waited on, so no completion is missed and finished work is never touched again
+    class Completion: protected Synchronizer_Common
+    {
+    public:
+        void wait(Future * f) {
+            begin_atomic();
+            while(!f->_done)
+                sleep();
+            end_atomic();
+        }
+
+        void signal(Future * f) {
+            begin_atomic();
+            f->_done = true;
+            wakeup_all();
+            end_atomic();
+        }
+    };
+
+public:
+    Executor() {}
+
+    static void submit(Future * future, Function * function, void * argument);
+    static int wait(Future * future);
+
+    static unsigned long executed() { return _executed; }
+    static unsigned long stolen() { return _stolen; }
+
+private:
+    static void start();
+    static int work(unsigned int n);
+    static int worker();
+    static Future * find(int n);
+    static void run(Future * f);
+
+private:
+    static volatile bool _started;
+    static volatile bool _starting;
+    static Thread * _workers[WORKERS];
+    static Deque _deque[WORKERS];
+    static Deque _inbox[Traits<Machine>::CPUS];
+    static Simple_Spin _inbox_lock[Traits<Machine>::CPUS];
+    static Semaphore _pending;
+    static Completion _completion;
+    static volatile unsigned long _executed;
+    static volatile unsigned long _stolen;
+};
+
+__END_SYS
+
+#endif
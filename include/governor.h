@@ -0,0 +1,96 @@
+// EPOS DVFS Governor Declarations
+
+#ifndef __governor_h
+#define __governor_h
+
+#include <architecture.h>
+#include <process.h>
+
+__BEGIN_SYS
+
+// Picks, on each CPU and every PERIOD, the clock the CPU should run at, according to a policy that can be changed at any
+// time. Decisions are taken on the CPU they concern (from the scheduler's time slicer and dispatcher), raise the clock at
+// once and lower it only by more than a step, so a single quiet period does not throttle a busy CPU. The latest TRACE
+// decisions of each CPU are kept and dumped when EPOS shuts down.
+class Governor
+{
+    friend class System;                        // for init()
+    friend class Thread;                        // for dispatch() and update()
+
+private:
+    static const unsigned int CPUS = Traits<Machine>::CPUS;
+    static const unsigned int TRACE = Traits<Governor>::enabled ? Traits<Governor>::TRACE : 1; // per CPU
+    static const unsigned int SMOOTHING = Traits<Governor>::SMOOTHING;
+    static const unsigned int UP_THRESHOLD = Traits<Governor>::UP_THRESHOLD;
+
+    typedef TSC::Time_Stamp Time_Stamp;
+
+public:
+    enum Policy {
+        PERFORMANCE = Traits<Governor>::PERFORMANCE,    // always max_clock()
+        POWERSAVE   = Traits<Governor>::POWERSAVE,      // always min_clock()
+        ONDEMAND    = Traits<Governor>::ONDEMAND,       // follows the (smoothed) load, keeping it around UP_THRESHOLD
+        DEADLINE    = Traits<Governor>::DEADLINE        // the lowest clock at which the periodic threads still meet their deadlines under EDF
+    };
+
+    struct Decision {
+        Microsecond time;
+        Policy policy;
+        Percent load;
+        Hertz from;
+        Hertz to;
+    };
+
+public:
+    Governor() {}
+
+    static Policy policy() { return _policy; }
+    static void policy(Policy p);
+
+    static Percent load(unsigned int cpu) { return _load[cpu]; }
+    static unsigned long decisions(unsigned int cpu) { return _decided[cpu]; }
+
+    static void dump();
+
+private:
+    // Idle time is accounted at each context switch, since idle threads halt the CPU instead of leaving it
+    static void dispatch(bool idle) {
+        unsigned int cpu = CPU::id();
+        Time_Stamp now = TSC::time_stamp();
+        if(_idling[cpu] && !idle)
+            _idle[cpu] += now - _idle_since[cpu];
+        else if(!_idling[cpu] && idle)
+            _idle_since[cpu] = now;
+        _idling[cpu] = idle;
+        if(idle) // CPUs going idle might not take time-slice interrupts anymore (see Scheduler_Timer::tickless)
+            update();
+    }
+
+    static void update() {
+        unsigned int cpu = CPU::id();
+        if(TSC::time_stamp() - _last[cpu] >= _period)
+            decide(cpu);
+    }
+
+    static void decide(unsigned int cpu);
+    static Hertz ondemand(unsigned int cpu);
+    static Hertz deadline(unsigned int cpu);
+
+    static void init();
+
+private:
+    static volatile Policy _policy;
+    static Time_Stamp _period;
+    static volatile bool _dumping;
+    static Time_Stamp _last[CPUS];
+    static Time_Stamp _idle[CPUS];
+    static Time_Stamp _idle_since[CPUS];
+    static bool _idling[CPUS];
+    static Percent _load[CPUS];
+    static Decision _trace[CPUS][TRACE];
+    static volatile unsigned long _decided[CPUS];
+};
+
+__END_SYS
+
+#endif
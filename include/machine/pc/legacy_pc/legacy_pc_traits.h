@@ -65,6 +65,11 @@ template<> struct Traits<Timer>: public Traits<Machine_Common>
     // 10000 Hz. The choice must respect the scheduler time-slice, i. e.,
     // it must be higher than the scheduler invocation frequency.
     static const int FREQUENCY = 1000; // Hz
+
+    // In tickless mode (multicores only, since it relies on the APIC timer's one-shot mode), the TSC keeps the time and
+    // each CPU's timer only interrupts at the next alarm or time-slice expiration (idle CPUs don't get interrupted at all).
+    // FREQUENCY then sets just the resolution of ticks, so it can be much higher than the range above.
+    static const bool tickless = false;
 };
 
 template<> struct Traits<RTC>: public Traits<Machine_Common>
@@ -531,8 +531,11 @@ public:
     using Engine::ipi;
     using Engine::irq2int;
 
+    // The context interrupted by the interrupt being handled on this CPU (e.g., for sampling profilers; see PMU::int_handler())
+    static CPU::Context * interrupted() { return _interrupted[CPU::id()]; }
+
 private:
-    static void dispatch(unsigned int i) __attribute__ ((thiscall));
+    static void dispatch(unsigned int i) __attribute__ ((thiscall, noinline)); // noinline: the interrupted context lies right above its frame
 
     // Logical handlers
     static void int_not(Interrupt_Id i);
@@ -548,6 +551,7 @@ private:
 
 private:
     static Interrupt_Handler _int_vector[INTS];
+    static CPU::Context * volatile _interrupted[Traits<Machine>::CPUS];
 };
 
 // Core id in IA32 is handled by the APIC
@@ -3,6 +3,7 @@
 #ifndef __pc_timer_h
 #define __pc_timer_h
 
+#include <architecture/tsc.h>
 #include <machine/machine.h>
 #include <machine/ic.h>
 #include <machine/rtc.h>
@@ -244,6 +245,11 @@ protected:
     typedef IF<Traits<System>::multicore, APIC_Timer, i8253>::Result Engine;
     typedef Engine::Count Count;
     typedef IC::Interrupt_Id Interrupt_Id;
+    typedef TSC::Time_Stamp Time_Stamp;
+
+public:
+    static const bool tickless = Traits<Timer>::tickless && multicore;
+    static const bool alarms_per_cpu = true;
 
 protected:
     Timer(Channel channel, Hertz frequency, Handler handler, bool retrigger = true)
@@ -255,8 +261,13 @@ protected:
         else
             db<Timer>(WRN) << "Timer not installed!"<< endl;
 
-        for(unsigned int i = 0; i < Traits<Machine>::CPUS; i++)
+        for(unsigned int i = 0; i < Traits<Machine>::CPUS; i++) {
             _current[i] = _initial;
+            _expiration[i] = 0;
+        }
+
+        if(tickless && (channel == USER))
+            expire(elapsed() + _initial, CPU::BSP);
     }
 
 public:
@@ -268,16 +279,48 @@ public:
 
     Tick read() { return _current[CPU::id()]; }
 
-    int restart() {
-        db<Timer>(TRC) << "Timer::restart() => {f=" << frequency() << ",h=" << reinterpret_cast<void *>(_handler) << ",count=" << _current[CPU::id()] << "}" << endl;
-
-        int percentage = _current[CPU::id()] * 100 / _initial;
-        _current[CPU::id()] = _initial;
+    // A limit makes the next interrupt come earlier than a full period (once), e.g. when a thread's budget ends before its quantum
+    int restart(Microsecond limit = 0) {
+        db<Timer>(TRC) << "Timer::restart(l=" << limit << ") => {f=" << frequency() << ",h=" << reinterpret_cast<void *>(_handler) << ",count=" << _current[CPU::id()] << "}" << endl;
+
+        Count count = _initial;
+        if(limit && (Count(ticks(limit, FREQUENCY)) < count))
+            count = ticks(limit, FREQUENCY) ? ticks(limit, FREQUENCY) : 1;
+
+        int percentage;
+        if(tickless) {
+            Time_Stamp now = TSC::time_stamp();
+            Time_Stamp expiration = _expiration[CPU::id()];
+            percentage = (expiration > now) ? (expiration - now) * 100 / (_initial * _tsc_per_tick) : 0;
+            expire(elapsed() + count, CPU::id());
+        } else {
+            percentage = _current[CPU::id()] * 100 / _initial;
+            _current[CPU::id()] = count;
+        }
 
         return percentage;
     }
 
-    static void reset() { db<Timer>(TRC) << "Timer::reset()" << endl; Engine::config(0, Engine::clock() / FREQUENCY); }
+    static Tick elapsed() { return (TSC::time_stamp() - _tsc_base) / _tsc_per_tick; }
+
+    // The user channel belongs to the BSP, the others are per CPU; another CPU's timer gets reprogrammed through an IPI
+    void expire(Tick tick, unsigned int cpu) {
+        cpu = owner(_channel, cpu);
+        _expiration[cpu] = _tsc_base + tick * _tsc_per_tick;
+        if(cpu == CPU::id())
+            program();
+        else
+            IC::ipi(cpu, IC::INT_SYS_TIMER);
+    }
+
+    void disarm(unsigned int cpu) {
+        cpu = owner(_channel, cpu);
+        _expiration[cpu] = 0; // a spurious interrupt might still come if the other CPU is not reprogrammed, but it is harmless
+        if(cpu == CPU::id())
+            program();
+    }
+
+    static void reset() { db<Timer>(TRC) << "Timer::reset()" << endl; if(!tickless) Engine::config(0, Engine::clock() / FREQUENCY); }
     static void enable() { db<Timer>(TRC) << "Timer::enable()" << endl; IC::enable(IC::INT_SYS_TIMER); }
     static void disable() { db<Timer>(TRC) << "Timer::disable()" << endl; IC::disable(IC::INT_SYS_TIMER); }
 
@@ -290,6 +333,10 @@ public:
 private:
     static void int_handler(Interrupt_Id i);
 
+    static void program();
+
+    static unsigned int owner(unsigned int channel, unsigned int cpu) { return (channel == USER) ? CPU::BSP : cpu; }
+
     static void init();
 
 protected:
@@ -297,9 +344,12 @@ protected:
     Count _initial;
     bool _retrigger;
     volatile Count _current[Traits<Machine>::CPUS];
+    volatile Time_Stamp _expiration[Traits<Machine>::CPUS]; // tickless only (0 => disarmed)
     Handler _handler;
 
     static Timer * _channels[CHANNELS];
+    static Time_Stamp _tsc_base;
+    static Time_Stamp _tsc_per_tick;
 };
 
 
@@ -314,7 +364,8 @@ public:
 class Alarm_Timer: public Timer
 {
 public:
-    Alarm_Timer(Handler handler): Timer(ALARM, FREQUENCY, handler) {}
+    // In tickless mode, Alarm programs each expiration itself
+    Alarm_Timer(Handler handler): Timer(ALARM, FREQUENCY, handler, !tickless) {}
 };
 
 
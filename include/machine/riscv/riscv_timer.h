@@ -28,6 +28,11 @@ protected:
 public:
     using Timer_Common::Tick;
     using Timer_Common::Handler;
+    using Timer_Common::tickless;
+    using Timer_Common::alarms_per_cpu;
+    using Timer_Common::elapsed;
+    using Timer_Common::expire;
+    using Timer_Common::disarm;
 
     // Channels
     enum {
@@ -60,11 +65,16 @@ public:
 
     Tick read() { return _current[CPU::id()]; }
 
-    int restart() {
-        db<Timer>(TRC) << "Timer::restart() => {f=" << frequency() << ",h=" << reinterpret_cast<void *>(_handler) << ",count=" << _current[CPU::id()] << "}" << endl;
+    // A limit makes the next interrupt come earlier than a full period (once), e.g. when a thread's budget ends before its quantum
+    int restart(Microsecond limit = 0) {
+        db<Timer>(TRC) << "Timer::restart(l=" << limit << ") => {f=" << frequency() << ",h=" << reinterpret_cast<void *>(_handler) << ",count=" << _current[CPU::id()] << "}" << endl;
+
+        Tick count = _initial;
+        if(limit && (ticks(limit, FREQUENCY) < count))
+            count = ticks(limit, FREQUENCY) ? ticks(limit, FREQUENCY) : 1;
 
         int percentage = _current[CPU::id()] * 100 / _initial;
-        _current[CPU::id()] = _initial;
+        _current[CPU::id()] = count;
 
         return percentage;
     }
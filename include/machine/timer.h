@@ -24,6 +24,13 @@ public:
     typedef long Tick;
     typedef IC_Common::Interrupt_Handler Handler;
 
+    // Tickless timers keep time with a free-running counter and are programmed in one-shot mode for the next expiration
+    // of each channel, instead of interrupting at every tick. Timers that support it override these.
+    static const bool tickless = false;
+
+    // Whether the alarm channel is driven by every CPU's timer, instead of only by the BSP's
+    static const bool alarms_per_cpu = false;
+
 protected:
     Timer_Common() {}
 
@@ -40,6 +47,10 @@ public:
 
     void handler(Handler handler);
 
+    static Tick elapsed() { return 0; }                 // ticks since the timer was initialized (tickless only)
+    void expire(Tick tick, unsigned int cpu) {}         // next expiration on a CPU, in elapsed() ticks (tickless only)
+    void disarm(unsigned int cpu) {}                    // no expiration at all on a CPU (tickless only)
+
     static Microsecond period(Hertz frequency) { return Microsecond(1000000) / Microsecond(frequency); }
     static Microsecond time(Tick ticks, Hertz frequency) { return Microsecond(ticks) * period(frequency); }
     static Tick ticks(Microsecond time, Hertz frequency) { return (time + period(frequency) / 2) / period(frequency); }
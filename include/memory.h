@@ -4,6 +4,7 @@
 #define __memory_h
 
 #include <architecture.h>
+#include <utility/pool.h>
 
 __BEGIN_SYS
 
@@ -29,7 +30,7 @@ public:
 };
 
 
-class Segment: public MMU::Chunk
+class Segment: public MMU::Chunk, public Pooled<Segment>
 {
 private:
     typedef MMU::Chunk Chunk;
@@ -8,6 +8,7 @@
 #include <utility/queue.h>
 #include <utility/vector.h>
 #include <utility/handler.h>
+#include <utility/pool.h>
 #include <scheduler.h>
 
 extern "C" {
@@ -17,13 +18,17 @@ extern "C" {
 
 __BEGIN_SYS
 
-class Thread
+class Thread: public Pooled<Thread, Traits<Thread>::CACHED>
 {
     friend class Init_End;                      // context->load()
     friend class Init_System;                   // for init() on CPU != 0
     friend class Scheduler<Thread>;             // for link()
     friend class Synchronizer_Common;           // for lock() and sleep()
     friend class Alarm;                         // for lock()
+    friend class Admission_Control;             // for lock() and _load
+    friend class Governor;                      // for _load
+    friend class Executor;                      // for _thread_count
+    friend class Coroutine;                     // for _thread_count
     friend class System;                        // for init()
     friend class IC;                            // for link() for priority ceiling
     friend volatile unsigned long ::_running(); // for running()
@@ -38,6 +43,57 @@ protected:
     typedef CPU::Log_Addr Log_Addr;
     typedef CPU::Context Context;
 
+    // Load tracking (see Load): averages move by 1/2^LOAD_DECAY of the distance to each new sample, and CPU-wide samples
+    // are taken over windows of at least LOAD_WINDOW us
+    static const unsigned int LOAD_DECAY = 3;
+    static const unsigned int LOAD_WINDOW = 1024;
+    static const unsigned int LOAD_CAPACITY = 1024; // utilization of a CPU that never idles
+    static const unsigned int NO_SLOT = -1U;
+
+    // Migration (see migration_cost()): threads stay at least MIGRATION_INTERVAL us where they were moved to, each line of
+    // their footprint costs MIGRATION_MISS_COST instructions to bring back in, lines left for more than CACHE_HOT us are
+    // taken as evicted, and moves must gain MIGRATION_HYSTERESIS % of the source CPU's load on top of what they cost
+    static const unsigned int MIGRATION_INTERVAL = 100000;
+    static const unsigned int MIGRATION_MISS_COST = 200;
+    static const unsigned int MIGRATION_HYSTERESIS = 10;
+    static const unsigned int CACHE_HOT = 5000;
+
+    // What each CPU (queue, for global criteria) has to do, as exponentially decayed averages updated incrementally: the
+    // threads' demands at the end of each of their jobs (see update_cost()) and the CPU's own throughput and utilization at
+    // the first dispatch after each window. Each one sits on cache lines of its own, since it is mostly touched by its own
+    // CPU, and keeps its threads in a set with O(1) insertion and removal (threads know their slots).
+    struct alignas(Traits<CPU>::CACHE_LINE_SIZE) Load {
+        volatile unsigned long long required;   // instructions per second the threads need (sum of their averages)
+        volatile unsigned long long misses;     // branch mispredictions per second the threads cause (idem)
+        volatile unsigned long long retired;    // instructions per second the CPU actually retired
+        volatile unsigned int utilization;      // of the CPU, in 1/LOAD_CAPACITY
+        volatile unsigned int count;
+        TSC::Time_Stamp window;                 // start of the current window
+        TSC::Time_Stamp dispatched;             // last dispatch
+        TSC::Time_Stamp busy;                   // non-idle time in the current window
+        unsigned long long instructions;        // instructions retired in the current window
+        Thread * threads[Traits<Machine>::MAX_THREADS];
+
+        void insert(Thread * t) {
+            t->_slot = count;
+            threads[count++] = t;
+        }
+
+        void remove(Thread * t) {
+            Thread * last = threads[--count];
+            threads[t->_slot] = last;
+            last->_slot = t->_slot;
+            threads[count] = 0;
+            t->_slot = NO_SLOT;
+        }
+
+        void account(TSC::Time_Stamp now, unsigned long long executed, bool idle);
+    };
+
+    static unsigned long long decayed(unsigned long long average, unsigned long long sample) {
+        return average ? (average * ((1ULL << LOAD_DECAY) - 1) + sample) >> LOAD_DECAY : sample;
+    }
+
 public:
     // Thread State
     enum State {
@@ -59,21 +115,38 @@ public:
         IDLE    = Criterion::IDLE
     };
 
-    // Thread Queue
-    typedef Ordered_Queue<Thread, Criterion, Scheduler<Thread>::Element> Queue;
+    // Thread Queue (used by synchronizers, which protect it with its own lock)
+    class Queue: public Ordered_Queue<Thread, Criterion, Scheduler<Thread>::Element>
+    {
+    public:
+        void lock() { _lock.acquire(); }
+        void unlock() { _lock.release(); }
+
+    private:
+        Simple_Spin _lock;
+    };
+
+    // Thread Affinity (a bitmap of the CPUs whose queues the thread may be moved to)
+    typedef unsigned long Affinity;
+    static const Affinity ANY_CPU = ~0UL;
 
     // Thread Configuration
     struct Configuration {
-        Configuration(State s = READY, Criterion c = NORMAL, unsigned int ss = STACK_SIZE)
-        : state(s), criterion(c), stack_size(ss) {}
+        Configuration(State s = READY, Criterion c = NORMAL, unsigned int ss = STACK_SIZE, Affinity a = ANY_CPU, const PMU::Event * e = 0, const PMU::Event * m = 0)
+        : state(s), criterion(c), stack_size(ss), affinity(a), events(e), multiplexed(m) {}
 
         State state;
         Criterion criterion;
         unsigned int stack_size;
+        Affinity affinity;
+        const PMU::Event * events; // one per PMU channel (PMU::UNUSED for channels not counted); 0 selects the default set
+        const PMU::Event * multiplexed; // more events to count by time multiplexing, terminated by PMU::UNUSED
     };
 
     unsigned long long instructions_per_second;
     unsigned long long branch_misprediction_per_second;
+    unsigned long long cache_miss_per_job;  // LLC misses of warm jobs
+    unsigned long long footprint;           // LLC lines a cold job misses on top of those, i.e. what a migration leaves behind
 
 
 public:
@@ -89,9 +162,16 @@ public:
 
     const volatile Criterion & priority() const { return _link.rank(); }
     void priority(Criterion p);
+
+    Affinity affinity() const { return _affinity; }
+    void affinity(Affinity a) { _affinity = a; }
+
+    PMU::Count pmu(PMU::Channel channel);
+    PMU::Count pmu_estimate(unsigned int i);
     void increase_cost();
     void decrease_cost();
     void update_cost();
+    unsigned long long migration_cost();
 
     Task * task() const { return _task; }
 
@@ -112,6 +192,7 @@ public:
     static unsigned int get_changes_count();
 
     static unsigned int get_thread_count(unsigned int cpu);
+    static unsigned int get_utilization(unsigned int cpu);
 
 
     
@@ -124,42 +205,105 @@ protected:
 
     static Thread * volatile running() { return _not_booting ? _scheduler.chosen() : reinterpret_cast<Thread * volatile>(CPU::id() + 1); }
 
+    // Each scheduling queue has its own lock, which guards the queue itself, the state of the threads assigned to it
+    // and the accounting of the CPU that serves it. lock() and unlock() operate on the queue of the current CPU, whose
+    // lock is handed over to the next thread at dispatch(). Synchronizer queues (Thread::Queue) and the Alarm queue have
+    // locks of their own. To avoid deadlocks, locks are always acquired in the following order, with interrupts disabled:
+    //     Thread::Queue or Alarm lock -> scheduling queue locks in ascending queue order
+    // Cross-queue operations either take both queue locks at once with lock(q1, q2) (e.g. priority() and
+    // change_thread_queue_if_necessary()) or extend the current lock with lock_another(), which gives up and retakes the
+    // current lock whenever the other queue comes first (e.g. join() and exit()). wakeup() and wakeup_all() take the
+    // locks of the awakened threads' queues one at a time. Only the current queue's lock may be held when dispatch() is
+    // invoked, so the CPUs of other queues are asked to reschedule through IPIs. Queue locks are never taken recursively.
+    // Migrations (see migrate()) take the locks of both alarm queues, in ascending order, before those of both queues.
     static void lock() {
         CPU::int_disable();
         if(smp)
-            _lock.acquire();
+            _lock[Criterion::current_queue()].acquire();
     }
 
     static void unlock() {
         if(smp)
-           _lock.release();
-        
+           _lock[Criterion::current_queue()].release();
+
+        if(_not_booting)
+            CPU::int_enable();
+    }
+
+    static void lock(unsigned int q) {
+        CPU::int_disable();
+        if(smp)
+            _lock[q].acquire();
+    }
+
+    static void unlock(unsigned int q) {
+        if(smp)
+           _lock[q].release();
+
         if(_not_booting)
-                CPU::int_enable();   
+            CPU::int_enable();
     }
 
-    static volatile bool locked() { return (smp) ? _lock.taken() : CPU::int_disabled(); }
+    static void lock(unsigned int q1, unsigned int q2) {
+        CPU::int_disable();
+        if(smp) {
+            _lock[(q1 < q2) ? q1 : q2].acquire();
+            if(q1 != q2)
+                _lock[(q1 < q2) ? q2 : q1].acquire();
+        }
+    }
+
+    static void unlock(unsigned int q1, unsigned int q2) {
+        if(smp) {
+            if(q1 != q2)
+                _lock[(q1 < q2) ? q2 : q1].release();
+            _lock[(q1 < q2) ? q1 : q2].release();
+        }
+
+        if(_not_booting)
+            CPU::int_enable();
+    }
+
+    static void lock_another(unsigned int q);
+    static unsigned int lock_another(Thread * t);
+    static void unlock_another(unsigned int q) {
+        if(smp && (q != Criterion::current_queue()))
+            _lock[q].release();
+    }
+
+    unsigned int lock_queue();
+
+    void update_criterion(Criterion::Event event);
+    static void unlock_queue(unsigned int q) {
+        if(smp)
+            _lock[q].release();
+    }
+
+    static volatile bool locked() { return (smp) ? _lock[Criterion::current_queue()].taken() : CPU::int_disabled(); }
 
     static void sleep(Queue * q);
     static void wakeup(Queue * q);
     static void wakeup_all(Queue * q);
 
     static void reschedule();
-    static void reschedule(unsigned int cpu);
+    static void reschedule(unsigned int q);
+    template<unsigned int H = Criterion::HEADS>
+    static unsigned int preempted_cpu(unsigned int q);
     static void rescheduler(IC::Interrupt_Id interrupt);
     static void time_slicer(IC::Interrupt_Id interrupt);
 
     static void dispatch(Thread * prev, Thread * next, bool charge = true);
 
-    static void for_all_threads(Criterion::Event event) {
-        for(Queue::Iterator i = _scheduler.begin(); i != _scheduler.end(); ++i)
-            if(i->object()->criterion() != IDLE)
-                i->object()->criterion().handle(event);
-    }
-
-    static Hertz calculate_frequency();
     static unsigned int select_cpu_by_use_rate();
     static void change_thread_queue_if_necessary();
+    static bool steal();
+
+    // Moves t to queue q, along with the alarm that releases its jobs, with both queues and their alarm queues locked
+    static void migrate(Thread * t, unsigned int q);
+
+    // Threads moved less than MIGRATION_INTERVAL ago stay put, so they do not bounce between CPUs, and so do threads whose
+    // footprint is not known yet (see update_cost())
+    bool settling(TSC::Time_Stamp now) const { return !_warmed || (_migrated && ((now - _migrated) / (TSC::frequency() / 1000000) < MIGRATION_INTERVAL)); }
 
     static int idle();
 
@@ -170,26 +314,34 @@ protected:
     Task * _task;
 
     char * _stack;
+    unsigned int _stack_size;
     Context * volatile _context;
     volatile State _state;
     Criterion _natural_priority;
     Queue * _waiting;
     Thread * volatile _joining;
     Queue::Element _link;
+    volatile Affinity _affinity;
+    PMU::Context _pmu;
+    unsigned int _slot; // in _load[criterion().queue()].threads, or NO_SLOT
+    TSC::Time_Stamp _migrated;
+    Alarm * _job_alarm; // periodic threads only, so their releases happen on the queue that runs them (see migrate())
+    bool _cold; // the next job to finish started with a cold cache (see update_cost())
+    bool _warmed; // a warm job has been measured, so cache_miss_per_job and footprint are known (see update_cost())
 
     alignas (int) static bool _not_booting;
     static volatile unsigned int _thread_count;
     static volatile unsigned int _changes_count;
-    static volatile unsigned int _cpu_thread_count[Traits<Machine>::CPUS];
-    static volatile Thread* _cpu_threads[Traits<Machine>::CPUS][Traits<Machine>::MAX_THREADS];
-    static volatile unsigned long long _cpu_last_dispatch[Traits<Machine>::CPUS];
-    static volatile unsigned long long _cpu_instructions_per_second[Traits<Machine>::CPUS];
-    static volatile unsigned long long _cpu_instructions_per_second_required[Traits<Machine>::CPUS];
-    static volatile unsigned long long _cpu_branch_missprediction_per_second[Traits<Machine>::CPUS];
+    static Load _load[Traits<Machine>::CPUS];
 
     static Scheduler_Timer * _timer;
     static Scheduler<Thread> _scheduler;
-    static Spin _lock;
+
+    // Stacks of STACK_SIZE, filled at init(), along with the pool of Thread objects, and refilled by the threads deleted on each CPU
+    static Pool<char[STACK_SIZE], Traits<Thread>::CACHED> _stacks;
+
+    struct alignas(Traits<CPU>::CACHE_LINE_SIZE) Queue_Lock: public Spin {};
+    static Queue_Lock _lock[Criterion::QUEUES];
 };
 
 class Task
@@ -225,14 +377,20 @@ public:
     static Task * volatile self() { return current(); }
 
 private:
+    // Threads on different scheduling queues can enroll and dismiss concurrently, so resources have a lock of their own
     template<typename T>
     void enroll(T * o) {
     	db<Task>(TRC) << "Task::enroll(t=" << Type<T>::ID << ", o=" << o << ")" << endl;
-    	_resources.insert(new (SYSTEM) Resource(o, Type<T>::ID));
+    	Resource * r = new (SYSTEM) Resource(o, Type<T>::ID);
+    	_lock.acquire();
+    	_resources.insert(r);
+    	_lock.release();
     }
     void dismiss(void * o) {
     	db<Task>(TRC) << "Task::dismiss(" << o << ")" << endl;
+    	_lock.acquire();
     	Resource * r = _resources.remove(o);
+    	_lock.release();
     	if(r) delete r;
     }
 
@@ -244,6 +402,7 @@ private:
 private:
     Thread * _main;
     Resources _resources;
+    Simple_Spin _lock;
 
     static Task * volatile _current;
 };
@@ -251,7 +410,8 @@ private:
 
 template<typename ... Tn>
 inline Thread::Thread(int (* entry)(Tn ...), Tn ... an)
-: _task(Task::self()), _state(READY), _waiting(0), _joining(0), _link(this, NORMAL)
+: instructions_per_second(0), branch_misprediction_per_second(0), cache_miss_per_job(0), footprint(0),
+  _task(Task::self()), _state(READY), _waiting(0), _joining(0), _link(this, NORMAL), _affinity(ANY_CPU), _pmu(), _slot(NO_SLOT), _migrated(0), _job_alarm(0), _cold(true), _warmed(false)
 {
     constructor_prologue(STACK_SIZE);
     _context = CPU::init_stack(0, _stack + STACK_SIZE, &__exit, entry, an ...);
@@ -260,7 +420,8 @@ inline Thread::Thread(int (* entry)(Tn ...), Tn ... an)
 
 template<typename ... Tn>
 inline Thread::Thread(Configuration conf, int (* entry)(Tn ...), Tn ... an)
-: _task(Task::self()), _state(conf.state), _waiting(0), _joining(0), _link(this, conf.criterion)
+: instructions_per_second(0), branch_misprediction_per_second(0), cache_miss_per_job(0), footprint(0),
+  _task(Task::self()), _state(conf.state), _waiting(0), _joining(0), _link(this, conf.criterion), _affinity(conf.affinity), _pmu(conf.events, conf.multiplexed), _slot(NO_SLOT), _migrated(0), _job_alarm(0), _cold(true), _warmed(false)
 {
     constructor_prologue(conf.stack_size);
     _context = CPU::init_stack(0, _stack + conf.stack_size, &__exit, entry, an ...);
@@ -0,0 +1,54 @@
+// EPOS Sampling Profiler Declarations
+
+#ifndef __profiler_h
+#define __profiler_h
+
+#include <architecture.h>
+#include <process.h>
+
+__BEGIN_SYS
+
+// Records, on each overflow of an armed PMU channel, which thread was running where; samples are kept in per-CPU rings
+// (the latest SAMPLES of each CPU) and dumped when EPOS shuts down (see tools/eposprof)
+class Profiler
+{
+public:
+    typedef PMU::Channel Channel;
+    typedef PMU::Event Event;
+    typedef PMU::Count Count;
+
+    static const unsigned int SAMPLES = Traits<Profiler>::enabled ? Traits<Profiler>::SAMPLES : 1; // per CPU
+
+    // The last programmable channel, which the default thread events leave free (see PMU::Context)
+    static const Channel CHANNEL = PMU::CHANNELS - 1;
+
+    struct Sample {
+        unsigned int cpu;
+        Thread * thread;
+        void * ip;
+        Event event;
+    };
+
+public:
+    Profiler() {}
+
+    static bool start(Event event, Count period, Channel channel = CHANNEL);
+    static void stop(Channel channel = CHANNEL);
+
+    static unsigned long samples(unsigned int cpu) { return _taken[cpu]; }
+
+    static void dump();
+
+private:
+    static void sample(Channel channel, void * ip);
+
+private:
+    static Event _event[PMU::CHANNELS];
+    static volatile bool _dumping;
+    static Sample _samples[Traits<Machine>::CPUS][SAMPLES];
+    static volatile unsigned long _taken[Traits<Machine>::CPUS];
+};
+
+__END_SYS
+
+#endif
@@ -15,6 +15,68 @@ __BEGIN_SYS
 // Aperiodic Thread
 typedef Thread Aperiodic_Thread;
 
+// Admission Control
+// Tells whether a scheduling queue can take one more periodic task without
+// missing deadlines, given the periodic threads it already has. Fixed-priority
+// criteria use response-time analysis, dynamic ones (e.g. EDF) use the
+// processor demand criterion and global ones (several CPUs per queue) use the
+// GFB density bound. Tasks with unknown capacity impose no demand. Placement
+// and the offline partitioning heuristics (first-fit and worst-fit decreasing
+// utilization) only pick queues that pass the test.
+class Admission_Control
+{
+private:
+    typedef Thread::Criterion Criterion;
+
+    static const unsigned int QUEUES = Criterion::QUEUES;
+    static const unsigned int HEADS = Criterion::HEADS;
+    static const unsigned int MAX_TASKS = Traits<Machine>::MAX_THREADS + 1;
+
+public:
+    static const unsigned int NONE = -1U;
+
+    enum Heuristic {
+        FIRST_FIT,
+        WORST_FIT
+    };
+
+    struct Task {
+        Task(Microsecond p = 0, Microsecond d = 0, Microsecond c = 0)
+        : period(p), deadline(d ? d : p), capacity(c), queue(NONE) {}
+
+        Microsecond period;
+        Microsecond deadline;
+        Microsecond capacity;
+        unsigned int queue; // set by partition()
+    };
+
+public:
+    static bool admissible(unsigned int queue, const Task & task);
+    static unsigned int place(const Task & task, Heuristic heuristic = FIRST_FIT);
+    static bool partition(Task * tasks, unsigned int n, Heuristic heuristic = FIRST_FIT);
+
+    // CPU to pass to the criterion of a thread to be placed in a queue
+    static unsigned int cpu(unsigned int queue) { return queue * Traits<Machine>::CPUS / QUEUES; }
+
+private:
+    struct Entry {
+        unsigned long long period;
+        unsigned long long deadline;
+        unsigned long long capacity;
+        int rank;
+    };
+
+    static Entry entry(const Task & task);
+    static unsigned int admitted(unsigned int queue, Entry * set);
+    static unsigned long long utilization(const Entry * set, unsigned int n);
+    static unsigned int fit(const Entry & task, Entry set[QUEUES][MAX_TASKS], unsigned int n[QUEUES], Heuristic heuristic);
+
+    static bool schedulable(const Entry * set, unsigned int n);
+    static bool response_time(const Entry * set, unsigned int n);
+    static bool processor_demand(const Entry * set, unsigned int n);
+    static bool density(const Entry * set, unsigned int n);
+};
+
 // Periodic threads are achieved by programming an alarm handler to invoke
 // p() on a control semaphore after each job (i.e. task activation). Base
 // threads are created in BEGINNING state, so the scheduler won't dispatch
@@ -49,7 +111,11 @@ protected:
         ~Dynamic_Handler() {}
 
         void operator()() {
-            _thread->criterion().handle(Criterion::JOB_RELEASE);
+            // A thread suspended for overrunning its previous job resumes with the new one
+            bool overran = (_thread->criterion().overrun() == Criterion::SUSPEND) && _thread->criterion().overran() && (_thread->state() == SUSPENDED);
+            _thread->update_criterion(Criterion::JOB_RELEASE);
+            if(overran)
+                _thread->resume();
             Semaphore_Handler::operator()();
         }
 
@@ -57,12 +123,13 @@ protected:
         Periodic_Thread * _thread;
     };
 
-    typedef IF<Criterion::dynamic | Traits<System>::monitored, Dynamic_Handler, Static_Handler>::Result Handler;
+    typedef IF<Criterion::dynamic | Criterion::enforced | Traits<System>::monitored, Dynamic_Handler, Static_Handler>::Result Handler;
 
 public:
     struct Configuration: public Thread::Configuration {
-        Configuration(Microsecond p, Microsecond d = SAME, Microsecond c = UNKNOWN, Microsecond a = NOW, const unsigned int n = INFINITE, State s = READY, unsigned int ss = STACK_SIZE)
-        : Thread::Configuration(s, Criterion(p, d, c, select_cpu_by_use_rate()), ss), activation(a), times(n) {}
+        Configuration(Microsecond p, Microsecond d = SAME, Microsecond c = UNKNOWN, Microsecond a = NOW, const unsigned int n = INFINITE, State s = READY, unsigned int ss = STACK_SIZE, Affinity af = ANY_CPU,
+                      Criterion::Overrun o = Criterion::IGNORE, Criterion::Overrun_Handler * h = 0, const PMU::Event * e = 0, const PMU::Event * m = 0)
+        : Thread::Configuration(s, Criterion(p, d, c, select_cpu_by_use_rate()), ss, af, e, m), activation(a), times(n) { criterion.overrun(o, h); }
 
         Microsecond activation;
         unsigned int times;
@@ -72,23 +139,39 @@ public:
     template<typename ... Tn>
     Periodic_Thread(Microsecond p, int (* entry)(Tn ...), Tn ... an)
     : Thread(Thread::Configuration(SUSPENDED, Criterion(p)), entry, an ...),
-      _semaphore(0), _handler(&_semaphore, this), _alarm(p, &_handler, INFINITE) {
+      _semaphore(0), _handler(&_semaphore, this), _alarm(p, &_handler, INFINITE, criterion().queue()) {
+        _job_alarm = &_alarm;
         resume();
-        criterion().handle(Criterion::JOB_RELEASE);
+        update_criterion(Criterion::JOB_RELEASE);
     }
 
     template<typename ... Tn>
     Periodic_Thread(Configuration conf, int (* entry)(Tn ...), Tn ... an)
-    : Thread(Thread::Configuration(SUSPENDED, conf.criterion, conf.stack_size), entry, an ...),
-      _semaphore(0), _handler(&_semaphore, this), _alarm(conf.criterion.period(), &_handler, conf.times) {
+    : Thread(Thread::Configuration(SUSPENDED, conf.criterion, conf.stack_size, conf.affinity, conf.events, conf.multiplexed), entry, an ...),
+      _semaphore(0), _handler(&_semaphore, this), _alarm(conf.criterion.period(), &_handler, conf.times, criterion().queue()) {
+        _job_alarm = &_alarm;
         if((conf.state == READY) || (conf.state == RUNNING)) {
             _state = SUSPENDED;
             resume();
-            criterion().handle(Criterion::JOB_RELEASE);
+            update_criterion(Criterion::JOB_RELEASE);
         } else
             _state = conf.state;
     }
 
+    // Creates the thread only if a queue admits it (see Admission_Control), placing it there; returns 0 otherwise
+    template<typename ... Tn>
+    static Periodic_Thread * admit(Configuration conf, int (* entry)(Tn ...), Tn ... an) {
+        Admission_Control::Task task(conf.criterion.period(), conf.criterion.deadline(), conf.criterion.capacity());
+        unsigned int queue = Admission_Control::place(task);
+        if(queue == Admission_Control::NONE) {
+            db<Thread>(WRN) << "Periodic_Thread::admit(p=" << task.period << ",d=" << task.deadline << ",c=" << task.capacity << ") => rejected!" << endl;
+            return 0;
+        }
+
+        conf.criterion = Criterion(task.period, task.deadline, task.capacity, Admission_Control::cpu(queue));
+        return new Periodic_Thread(conf, entry, an ...);
+    }
+
     Microsecond period() const { return _alarm.period(); }
     void period(Microsecond p) { _alarm.period(p); }
 
@@ -98,7 +181,9 @@ public:
         db<Thread>(TRC) << "Thread::wait_next(this=" << t << ",times=" << t->_alarm.times() << ")" << endl;
 
         t->criterion().handle(Criterion::JOB_FINISH);
+        lock();
         t->update_cost();
+        unlock();
 
         if(t->_alarm.times())
             t->_semaphore.p();
@@ -130,9 +215,11 @@ private:
 
             t->criterion().handle(Criterion::JOB_RELEASE);
 
-            // Adjust alarm's period
+            // Adjust alarm's period (it is not moved along with the thread meanwhile)
+            t->_job_alarm = 0;
             t->_alarm.~Alarm();
-            new (&t->_alarm) Alarm(t->criterion().period(), &t->_handler, n);
+            new (&t->_alarm) Alarm(t->criterion().period(), &t->_handler, n, t->criterion().queue());
+            t->_job_alarm = &t->_alarm;
         }
 
         // Periodic execution loop
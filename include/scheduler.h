@@ -62,9 +62,20 @@ public:
         LEAVE = 1 << 3,
         JOB_RELEASE = 1 << 4,
         JOB_FINISH = 1 << 5,
-        JOB_RESTART = 1 << 6        
+        JOB_RESTART = 1 << 6,
+        OVERRUN = 1 << 7            // the current job has exhausted its capacity (see Thread::time_slicer())
     };
 
+    // What to do with a job that exhausts its capacity
+    enum Overrun
+    {
+        IGNORE,                     // nothing (no budget is enforced)
+        DEMOTE,                     // lower the thread to background priority until its next release
+        SUSPEND,                    // suspend the thread until its next release
+        NOTIFY                      // invoke the overrun handler (in interrupt context, on behalf of the thread)
+    };
+    typedef void (Overrun_Handler)();
+
     // Policy operations
     typedef int Operation;
     enum
@@ -79,7 +90,10 @@ public:
     static const bool timed = false;
     static const bool dynamic = false;
     static const bool preemptive = true;
+    static const bool stealing = false;     // idle CPUs take READY threads from other queues (see Thread::steal())
+    static const bool enforced = false;     // jobs can be kept from running beyond their capacity (see Thread::time_slicer())
     static const unsigned int QUEUES = 1;
+    static const unsigned int HEADS = 1;
 
     // Runtime Statistics (for policies that don't use any; that's why its a union)
     union Dummy_Statistics
@@ -141,9 +155,19 @@ public:
 
     bool periodic() { return false; }
 
+    Overrun overrun() const { return IGNORE; }
+    void overrun(Overrun o, Overrun_Handler * h = 0) {}
+    Overrun_Handler * overrun_handler() const { return 0; }
+    bool overran() const { return false; }
+    bool exhausted() { return false; }
+    Microsecond job_budget() { return 0; }
+
     volatile Statistics & statistics() { return _statistics; }
     unsigned int queue() const { return 0; }
 
+    static unsigned int current_queue() { return 0; }
+    static unsigned int current_head() { return 0; }
+
 
 protected:
     void handle(Event event) {}
@@ -162,7 +186,7 @@ class Priority : public Scheduling_Criterion_Common
 
 public:
     template <typename... Tn>
-    Priority(int p = NORMAL, Tn &...an) : _priority(p) {}
+    Priority(int p = NORMAL, const Tn &... an) : _priority(p) {}
 
     operator const volatile int() const volatile { return _priority; }
 
@@ -180,7 +204,7 @@ public:
 
 public:
     template <typename... Tn>
-    RR(int p = NORMAL, Tn &...an) : Priority(p) {}
+    RR(int p = NORMAL, const Tn &... an) : Priority(p) {}
 };
 
 // First-Come, First-Served (FIFO)
@@ -193,7 +217,7 @@ public:
 
 public:
     template <typename... Tn>
-    FCFS(int p = NORMAL, Tn &...an);
+    FCFS(int p = NORMAL, const Tn &... an);
 };
 
 
@@ -222,7 +246,7 @@ public:
 
 public:
     template <typename ... Tn>
-    GRR(int p = NORMAL, Tn & ... an): RR(p) {}
+    GRR(int p = NORMAL, const Tn & ... an): RR(p) {}
 
     static unsigned int current_head() { return CPU::id(); }
 };
@@ -239,7 +263,7 @@ public:
 
 public:
     template <typename ... Tn>
-    Fixed_CPU(int p = NORMAL, unsigned int cpu = ANY, Tn & ... an)
+    Fixed_CPU(int p = NORMAL, unsigned int cpu = ANY, const Tn & ... an)
     : Priority(p), Variable_Queue_Scheduler(((_priority == IDLE) || (_priority == MAIN)) ? CPU::id() : (cpu != ANY) ? cpu : ++_next_queue %= CPU::cores()) {}
 
     using Variable_Queue_Scheduler::queue;
@@ -254,11 +278,12 @@ public:
     static const bool dynamic = false;
     static const bool preemptive = true;
     static const bool heuristic = true;
+    static const bool stealing = true;
     static const unsigned int QUEUES = Traits<Machine>::CPUS;
 
 public:
     template <typename ... Tn>
-    CPU_Affinity(int p = NORMAL, unsigned int cpu = ANY, Tn & ... an)
+    CPU_Affinity(int p = NORMAL, unsigned int cpu = ANY, const Tn & ... an)
     : Priority(p), Variable_Queue_Scheduler(((_priority == IDLE) || (_priority == MAIN)) ? CPU::id() : (cpu != ANY) ? cpu : ++_next_queue %= CPU::cores()) {}
 
     bool charge(bool end = false);
@@ -280,17 +305,26 @@ class RT_Common : public Priority
 public:
     static const bool timed = true;
     static const bool preemptive = true;
+    static const bool enforced = true;
 
 protected:
-    RT_Common(int i) : Priority(i), _period(0), _deadline(0), _capacity(0) {} // aperiodic
-    RT_Common(int i, Microsecond p, Microsecond d, Microsecond c) : Priority(i), _period(ticks(p)), _deadline(ticks(d ? d : p)), _capacity(ticks(c)) {}
+    RT_Common(int i) : Priority(i), _period(0), _deadline(0), _capacity(0), _dispatch(0), _usage(0), _released(false), _overran(false), _demoted(0), _overrun(IGNORE), _overrun_handler(0) {} // aperiodic
+    RT_Common(int i, Microsecond p, Microsecond d, Microsecond c) : Priority(i), _period(ticks(p)), _deadline(ticks(d ? d : p)), _capacity(ticks(c)), _dispatch(0), _usage(0), _released(false), _overran(false), _demoted(0), _overrun(IGNORE), _overrun_handler(0) {}
 
 public:
     Microsecond period() { return time(_period); }
     Microsecond deadline() { return time(_deadline); }
     Microsecond capacity() { return time(_capacity); }
 
-    bool periodic() { return (_priority >= PERIODIC) && (_priority <= SPORADIC); }
+    bool periodic() { int p = demoted() ? _demoted : _priority; return (p >= PERIODIC) && (p <= SPORADIC); }
+
+    // Budget enforcement: the time each job runs is accounted at ENTER and LEAVE, independently of statistics
+    Overrun overrun() const { return _overrun; }
+    void overrun(Overrun o, Overrun_Handler * h = 0) { _overrun = o; _overrun_handler = h; }
+    Overrun_Handler * overrun_handler() const { return _overrun_handler; }
+    bool overran() const { return _overran; }
+    bool exhausted();           // the running job has just used up its capacity
+    Microsecond job_budget();   // time the current job can still run before overrunning (0 if not enforced)
 
     volatile Statistics &statistics() { return _statistics; }
 
@@ -300,6 +334,8 @@ protected:
 
     void handle(Event event);
 
+    bool demoted() const { return _overran && (_overrun == DEMOTE); }
+
     static Tick elapsed();
 
 protected:
@@ -307,6 +343,14 @@ protected:
     Tick _deadline;
     Tick _capacity;
     Statistics _statistics;
+
+    Tick _dispatch;             // when the thread last entered the CPU
+    Tick _usage;                // time used by the current job
+    bool _released;
+    bool _overran;
+    int _demoted;               // priority before demotion
+    Overrun _overrun;
+    Overrun_Handler * _overrun_handler;
 };
 
 // Rate Monotonic
@@ -351,7 +395,7 @@ public:
 
 public:
     EDF(int p = APERIODIC): RT_Common(p) {}
-    EDF(Microsecond p, Microsecond d = SAME, Microsecond c = UNKNOWN);
+    EDF(Microsecond p, Microsecond d = SAME, Microsecond c = UNKNOWN, unsigned int cpu = ANY);
 
 
     void handle(Event event);
@@ -371,11 +415,59 @@ public:
     void handle(Event event);
 };
 
+// Global Earliest Deadline First (all CPUs share a single deadline-ordered queue, with one head per CPU, so jobs migrate freely)
+class GEDF: public EDF
+{
+public:
+    static const unsigned int HEADS = Traits<Machine>::CPUS;
+
+public:
+    GEDF(int p = APERIODIC): EDF(p) {}
+    GEDF(Microsecond p, Microsecond d = SAME, Microsecond c = UNKNOWN, unsigned int cpu = ANY): EDF(p, d, c, cpu) {}
+
+    static unsigned int current_head() { return CPU::id(); }
+};
+
+// Constant Bandwidth Server (EDF, plus servers that let aperiodic threads use up to a budget Q every period T)
+// A server's rank is its deadline. Its execution is charged at LEAVE and at each time slice (CHARGE); each time the budget
+// runs out, the deadline is postponed by T (throttling the server) and the budget is replenished. A server dispatched with
+// more budget left than its bandwidth allows until the current deadline starts over with deadline now + T and a full budget.
+class CBS: public EDF
+{
+public:
+    struct Server {
+        Server(Microsecond b, Microsecond p): budget(b), period(p) {}
+
+        Microsecond budget;
+        Microsecond period;
+    };
+
+public:
+    CBS(int p = APERIODIC): EDF(p), _server(false), _budget(0), _last_charge(0) {}
+    CBS(Microsecond p, Microsecond d = SAME, Microsecond c = UNKNOWN, unsigned int cpu = ANY): EDF(p, d, c, cpu), _server(false), _budget(0), _last_charge(0) {}
+    CBS(const Server & s);
+
+    bool server() const { return _server; }
+    Microsecond budget() { return time(_budget); }
+
+    void handle(Event event);
+
+private:
+    void charge(Tick used);
+
+private:
+    bool _server;
+    Tick _budget;
+    Tick _last_charge;
+};
+
 
 
 class MyScheduler: public EDF, public Variable_Queue_Scheduler
 {
 public:
+    static const bool stealing = true;
+
     // QUEUES x HEADS must be equal to Traits<Machine>::CPUS
     static const unsigned int HEADS = 1;
     static const unsigned int QUEUES = Traits<Machine>::CPUS / HEADS;
@@ -409,13 +501,51 @@ template<typename T>
 class Scheduling_Queue<T, GRR>:
 public Multihead_Scheduling_List<T> {};
 
+// Dynamic criteria change ranks, so they use pairing heaps that can reorder a single thread without walking the queue
+template<typename T>
+class Scheduling_Queue<T, EDF>:
+public Heap_Scheduling_List<T> {};
+
+template<typename T>
+class Scheduling_Queue<T, LLF>:
+public Heap_Scheduling_List<T> {};
+
+template<typename T>
+class Scheduling_Queue<T, CBS>:
+public Heap_Scheduling_List<T> {};
+
+template<typename T>
+class Scheduling_Queue<T, GEDF>:
+public Multihead_Scheduling_List<T> {};
+
 template<typename T>
 class Scheduling_Queue<T, MyScheduler>:
-public Scheduling_Multilist<T> {};
+public Scheduling_Multilist<T, MyScheduler, List_Elements::Doubly_Linked_Scheduling_Heap<T, MyScheduler>, Heap_Scheduling_List<T, MyScheduler> > {};
+
+// Static criteria never reorder queued threads, so they can use constant-time bitmap-indexed lists
+template<typename T>
+class Scheduling_Queue<T, Priority>:
+public Bitmap_Scheduling_List<T> {};
+
+template<typename T>
+class Scheduling_Queue<T, RR>:
+public Bitmap_Scheduling_List<T> {};
+
+template<typename T>
+class Scheduling_Queue<T, RM>:
+public Bitmap_Scheduling_List<T> {};
+
+template<typename T>
+class Scheduling_Queue<T, DM>:
+public Bitmap_Scheduling_List<T> {};
+
+template<typename T>
+class Scheduling_Queue<T, LM>:
+public Bitmap_Scheduling_List<T> {};
 
 template<typename T>
 class Scheduling_Queue<T, Fixed_CPU>:
-public Scheduling_Multilist<T> {};
+public Scheduling_Multilist<T, Fixed_CPU, List_Elements::Doubly_Linked_Scheduling_Bitmap<T, Fixed_CPU>, Bitmap_Scheduling_List<T, Fixed_CPU> > {};
 
 template<typename T>
 class Scheduling_Queue<T, CPU_Affinity>:
@@ -23,9 +23,19 @@ protected:
     long finc(volatile long & number) { return CPU::finc(number); }
     long fdec(volatile long & number) { return CPU::fdec(number); }
 
-    // Thread operations
-    void begin_atomic() { Thread::lock(); }
-    void end_atomic() { Thread::unlock(); }
+    // Thread operations (the queue's lock precedes the scheduling queue locks, see Thread::lock())
+    void begin_atomic() {
+        CPU::int_disable();
+        if(Thread::smp)
+            _queue.lock();
+    }
+
+    void end_atomic() {
+        if(Thread::smp)
+            _queue.unlock();
+        if(Thread::_not_booting)
+            CPU::int_enable();
+    }
 
     void sleep() { Thread::sleep(&_queue); }
     void wakeup() { Thread::wakeup(&_queue); }
@@ -50,7 +60,7 @@ private:
 };
 
 
-class Semaphore: protected Synchronizer_Common
+class Semaphore: protected Synchronizer_Common, public Pooled<Semaphore>
 {
 public:
     Semaphore(long v = 1);
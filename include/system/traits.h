@@ -117,6 +117,7 @@ class GRR;
 class Fixed_CPU;
 class CPU_Affinity;
 class GEDF;
+class CBS;
 class PEDF;
 class CEDF;
 class PRM;
@@ -138,6 +139,10 @@ class Delay;
 
 template<typename T> class Clerk;
 class Monitor;
+class Profiler;
+class Governor;
+class Executor;
+class Coroutine;
 
 class Network;
 class ELP;
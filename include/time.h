@@ -29,19 +29,26 @@ public:
 };
 
 
-class Alarm
+class Alarm: public Pooled<Alarm>
 {
     friend class System;                        // for init()
     friend class Alarm_Chronometer;             // for elapsed()
     friend class FCFS;                          // for elapsed()
-    friend class Thread;                        // for elapsed()
+    friend class Thread;                        // for elapsed(), lock() and queue()
     friend class RT_Common;                     // for elapsed()
-    friend class Periodic_Thread;               // for times()
+    friend class Periodic_Thread;               // for times() and Alarm(..., queue)
+    friend class RT_Thread;                     // for Alarm(..., queue)
     friend class EDF;                           // for ticks() and elapsed()
 
 private:
     typedef Timer_Common::Tick Tick;
-    typedef Relative_Queue<Alarm, Tick> Queue;
+    typedef Timing_Wheel<Alarm, Tick> Queue;
+
+    // Each scheduling queue has its own alarm queue, driven by the timer of the queue's first CPU, so the releases of
+    // periodic threads happen on the CPU that runs them, without IPIs nor contention among CPUs (machines whose alarm
+    // channel is driven only by the BSP's timer still get the per-queue locks)
+    static const unsigned int QUEUES = Thread::Criterion::QUEUES;
+    static const unsigned int CPUS_PER_QUEUE = Traits<Machine>::CPUS / QUEUES;
 
 public:
     Alarm(Microsecond time, Handler * handler, unsigned int times = 1);
@@ -57,18 +64,74 @@ public:
     static void delay(Microsecond time);
 
 private:
+    Alarm(Microsecond time, Handler * handler, unsigned int times, unsigned int queue);
+
     unsigned int times() const { return _times; }
 
-    static volatile Tick & elapsed() { return _elapsed; }
+    static Tick elapsed() { return (Alarm_Timer::tickless) ? Alarm_Timer::elapsed() : _elapsed; }
 
     static Alarm_Timer * timer() { return _timer; }
 
     static Tick ticks(Microsecond time) { return Timer_Common::ticks(time, frequency()); }
 
-    static void lock() { Thread::lock(); }
-    static void unlock() { Thread::unlock(); }
+    static unsigned int cpu(unsigned int queue) { return (Alarm_Timer::alarms_per_cpu) ? queue * CPUS_PER_QUEUE : CPU::BSP; }
+
+    // Each alarm queue has a lock of its own, which precedes the scheduling queue locks (see Thread::lock())
+    static void lock(unsigned int q) {
+        CPU::int_disable();
+        if(Thread::smp)
+            _lock[q].acquire();
+    }
+
+    static void unlock(unsigned int q) {
+        if(Thread::smp)
+            _lock[q].release();
+        if(Thread::_not_booting)
+            CPU::int_enable();
+    }
+
+    // Both locks are taken to move an alarm between queues (see Thread::migrate()), in ascending queue order
+    static void lock(unsigned int q1, unsigned int q2) {
+        CPU::int_disable();
+        if(Thread::smp) {
+            _lock[(q1 < q2) ? q1 : q2].acquire();
+            if(q1 != q2)
+                _lock[(q1 < q2) ? q2 : q1].acquire();
+        }
+    }
+
+    static void unlock(unsigned int q1, unsigned int q2) {
+        if(Thread::smp) {
+            if(q1 != q2)
+                _lock[(q1 < q2) ? q2 : q1].release();
+            _lock[(q1 < q2) ? q1 : q2].release();
+        }
+        if(Thread::_not_booting)
+            CPU::int_enable();
+    }
+
+    static volatile bool locked(unsigned int q) { return (Thread::smp) ? _lock[q].taken() : CPU::int_disabled(); }
+
+    // An alarm only changes queues while both of them are locked, so retry if it moved before we got there
+    unsigned int lock_queue() {
+        unsigned int q = _queue;
+        lock(q);
+        while(_queue != q) {
+            unlock(q);
+            q = _queue;
+            lock(q);
+        }
+        return q;
+    }
+
+    // Moves the alarm, with any pending expiration, to queue q (both queues locked)
+    void queue(unsigned int q);
+
+    // Tickless timers don't interrupt at every tick, so they are programmed for the next slot the wheel reaches
+    static void program(unsigned int q);
 
     static void handler(IC::Interrupt_Id i);
+    static void handle(unsigned int q);
 
     static void init();
 
@@ -77,11 +140,13 @@ private:
     Handler * _handler;
     unsigned int _times;
     Tick _ticks;
+    volatile unsigned int _queue;
     Queue::Element _link;
 
     static Alarm_Timer * _timer;
     static volatile Tick _elapsed;
-    static Queue _request;
+    static Queue _request[QUEUES];
+    static Spin _lock[QUEUES];
 };
 
 
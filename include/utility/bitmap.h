@@ -54,6 +54,49 @@ public:
         return true;
     }
 
+    bool test(unsigned int index) const {
+        return (index < BITS) && (_map[index / BPI] & (1 << (index & mask)));
+    }
+
+    // Index of the lowest bit set (-1 if none)
+    int first() const {
+        for(unsigned int i = 0; i < SIZE; i++)
+            if(_map[i])
+                return i * BPI + __builtin_ctz(_map[i]);
+        return -1;
+    }
+
+    // Index of the lowest bit set above "index" (-1 if none)
+    int first_after(unsigned int index) const {
+        index++;
+        if(index >= BITS)
+            return -1;
+        unsigned int i = index / BPI;
+        unsigned int word = _map[i] & ~((1U << (index & mask)) - 1);
+        if(word)
+            return i * BPI + __builtin_ctz(word);
+        for(i++; i < SIZE; i++)
+            if(_map[i])
+                return i * BPI + __builtin_ctz(_map[i]);
+        return -1;
+    }
+
+    // Index of the highest bit set below "index" (-1 if none)
+    int last_before(unsigned int index) const {
+        if(index > BITS)
+            index = BITS;
+        int i = index / BPI;
+        if(index & mask) {
+            unsigned int word = _map[i] & ((1U << (index & mask)) - 1);
+            if(word)
+                return i * BPI + BPI - 1 - __builtin_clz(word);
+        }
+        for(i--; i >= 0; i--)
+            if(_map[i])
+                return i * BPI + BPI - 1 - __builtin_clz(_map[i]);
+        return -1;
+    }
+
 private:
      unsigned int _map[SIZE];
 };
@@ -0,0 +1,187 @@
+// EPOS Buddy Allocator Utility Declarations
+
+#ifndef __buddy_h
+#define __buddy_h
+
+#include <system/config.h>
+
+__BEGIN_UTIL
+
+// Buddy Allocator
+// Free frames (of 2^SHIFT bytes) are kept in blocks of 2^order frames, aligned to their size, with a list per order.
+// A block's buddy, the other half of the block of the next order, is found by flipping a bit of its frame number, so
+// freeing a block merges it with its buddy, and the result with its own, in O(ORDERS) steps. An allocation of n frames
+// splits the smallest free block of at least n frames in halves, down to the order of n, and gives back the frames
+// beyond n, so runs that are not powers of two waste no memory. Blocks are split keeping their lower halves free and
+// runs are taken from the top of blocks, so, as with a grouping list, memory is handed out from the top, and only the
+// first frame of each free block is written to (with its list links). Whether a block is free is kept apart, in a map
+// with a bit per block of each order, which several allocators (e.g., one per color) can share, since each only merges
+// blocks with buddies of its own.
+template<unsigned int SHIFT, unsigned int ORDERS>
+class Buddy
+{
+private:
+    static const unsigned int WORD = sizeof(unsigned long) * 8;
+
+    struct Block {
+        Block * prev;
+        Block * next;
+        Buddy * owner;
+    };
+
+public:
+    // Static allocators only: members are left as zero-initialized, for MMU::init() may run before global constructors
+    Buddy() {}
+
+    // Bytes of the map for frames [0, frames)
+    static unsigned long map_size(unsigned long frames) {
+        unsigned long bits = 0;
+        for(unsigned int o = 0; o < ORDERS; o++)
+            bits += (frames >> o) + 1;
+        return (bits + WORD - 1) / WORD * sizeof(unsigned long);
+    }
+
+    // Frames are numbered from address origin (blocks are aligned relative to it), and the map must have been zeroed
+    void map(void * map, unsigned long origin, unsigned long frames) {
+        _map = reinterpret_cast<unsigned long *>(map);
+        _origin = origin;
+        _frames = frames;
+        unsigned long bits = 0;
+        for(unsigned int o = 0; o < ORDERS; o++) {
+            _offset[o] = bits;
+            bits += (frames >> o) + 1;
+        }
+    }
+
+    void * alloc(unsigned long frames) {
+        if(!frames)
+            return 0;
+
+        unsigned int order = 0;
+        while((order < ORDERS) && ((1UL << order) < frames))
+            order++;
+
+        unsigned int o = order;
+        while((o < ORDERS) && !_head[o])
+            o++;
+        if(o >= ORDERS)
+            return 0;
+
+        unsigned long f = frame(_head[o]);
+        remove(f, o);
+        while(o > order) {
+            o--;
+            insert(f, o);
+            f += 1UL << o;
+        }
+
+        unsigned long extra = (1UL << order) - frames;
+        if(extra)
+            release(f, extra);
+
+        return address(f + extra);
+    }
+
+    void free(void * addr, unsigned long frames) { release(frame(addr), frames); }
+
+    unsigned long grouped_size() const { return _grouped_size; } // free frames
+    unsigned long blocks(unsigned int order) const { return (order < ORDERS) ? _count[order] : 0; }
+
+    unsigned long largest() const {
+        for(unsigned int o = ORDERS; o--; )
+            if(_head[o])
+                return 1UL << o;
+        return 0;
+    }
+
+    // Unusable free space index: the percentage of the free frames that lie in blocks too small for 2^order frames
+    unsigned int fragmentation(unsigned int order) const {
+        if(!_grouped_size)
+            return 0;
+
+        unsigned long usable = 0;
+        for(unsigned int o = order; o < ORDERS; o++)
+            usable += _count[o] << o;
+        return (_grouped_size - usable) * 100 / _grouped_size;
+    }
+
+private:
+    unsigned long frame(void * addr) const { return (reinterpret_cast<unsigned long>(addr) - _origin) >> SHIFT; }
+    void * address(unsigned long f) const { return reinterpret_cast<void *>(_origin + (f << SHIFT)); }
+    Block * block(unsigned long f) const { return reinterpret_cast<Block *>(address(f)); }
+
+    // Runs are split in the largest aligned blocks that fit, each merged with its buddies
+    void release(unsigned long f, unsigned long frames) {
+        while(frames) {
+            unsigned int o = 0;
+            while((o + 1 < ORDERS) && !(f & (1UL << o)) && ((2UL << o) <= frames))
+                o++;
+            merge(f, o);
+            f += 1UL << o;
+            frames -= 1UL << o;
+        }
+    }
+
+    void merge(unsigned long f, unsigned int o) {
+        for(; o + 1 < ORDERS; o++) {
+            unsigned long b = f ^ (1UL << o);
+            if((b + (1UL << o) > _frames) || !marked(b, o) || (block(b)->owner != this))
+                break;
+            remove(b, o);
+            f &= ~(1UL << o);
+        }
+        insert(f, o);
+    }
+
+    void insert(unsigned long f, unsigned int o) {
+        Block * b = block(f);
+        b->owner = this;
+        b->prev = 0;
+        b->next = _head[o];
+        if(_head[o])
+            _head[o]->prev = b;
+        _head[o] = b;
+        _count[o]++;
+        _grouped_size += 1UL << o;
+        mark(f, o, true);
+    }
+
+    void remove(unsigned long f, unsigned int o) {
+        Block * b = block(f);
+        if(b->prev)
+            b->prev->next = b->next;
+        else
+            _head[o] = b->next;
+        if(b->next)
+            b->next->prev = b->prev;
+        _count[o]--;
+        _grouped_size -= 1UL << o;
+        mark(f, o, false);
+    }
+
+    bool marked(unsigned long f, unsigned int o) const {
+        unsigned long i = _offset[o] + (f >> o);
+        return _map[i / WORD] & (1UL << (i % WORD));
+    }
+
+    void mark(unsigned long f, unsigned int o, bool listed) {
+        unsigned long i = _offset[o] + (f >> o);
+        if(listed)
+            _map[i / WORD] |= 1UL << (i % WORD);
+        else
+            _map[i / WORD] &= ~(1UL << (i % WORD));
+    }
+
+private:
+    unsigned long * _map;
+    unsigned long _origin;
+    unsigned long _frames;
+    unsigned long _offset[ORDERS];
+    Block * _head[ORDERS];
+    unsigned long _count[ORDERS];
+    unsigned long _grouped_size;
+};
+
+__END_UTIL
+
+#endif
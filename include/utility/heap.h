@@ -6,88 +6,408 @@
 #include <utility/debug.h>
 #include <utility/list.h>
 #include <utility/spin.h>
+#include <utility/bitmap.h>
 
 __BEGIN_UTIL
 
 // Heap
-class Heap_Imp: private Grouping_List<char>
+// First-fit over an unordered list of free regions, each carved from its end, so allocations that leave some of a region
+// free do not touch the list. Blocks carry boundary tags: every block starts with a word holding its size and whether it
+// and the block before it are in use, and free regions also end with their size, so free() merges a block with both of
+// its neighbors in constant time. Each region handed to free(addr, bytes) ends in a used sentinel, so blocks are never
+// merged across regions.
+class Heap_Imp: private List<char, List_Elements::Doubly_Linked_Grouping<char>>
 {
 protected:
     static const bool typed = Traits<System>::multiheap;
 
+private:
+    typedef List<char, List_Elements::Doubly_Linked_Grouping<char>> Base;
+
+    static const unsigned long ALIGN = sizeof(void *);
+    static const unsigned long USED = 1;
+    static const unsigned long PREV_USED = 2;
+    static const unsigned long FLAGS = USED | PREV_USED;
+    static const unsigned long TAG = sizeof(long);
+    static const unsigned long MIN_FREE = TAG + sizeof(Element) + sizeof(long); // tag, list element and size at the end
+
 public:
-    using Grouping_List<char>::empty;
-    using Grouping_List<char>::size;
-    using Grouping_List<char>::grouped_size;
+    using Base::empty;
+    using Base::size;
 
-    Heap_Imp() {
+    Heap_Imp(): _grouped_size(0) {
         db<Init, Heaps>(TRC) << "Heap() => " << this << endl;
     }
 
-    Heap_Imp(void * addr, unsigned long bytes) {
+    Heap_Imp(void * addr, unsigned long bytes): _grouped_size(0) {
         db<Init, Heaps>(TRC) << "Heap(addr=" << addr << ",bytes=" << bytes << ") => " << this << endl;
 
         free(addr, bytes);
     }
 
+    unsigned long grouped_size() const { return _grouped_size; }
+
     void * alloc(unsigned long bytes) {
         db<Heaps>(TRC) << "Heap::alloc(this=" << this << ",bytes=" << bytes;
 
         if(!bytes)
             return 0;
 
-        if(!Traits<CPU>::unaligned_memory_access)
-            while((bytes % sizeof(void *)))
-                ++bytes;
-
         if(typed)
             bytes += sizeof(void *);  // add room for heap pointer
-        bytes += sizeof(long);        // add room for size
-        if(bytes < sizeof(Element))
-            bytes = sizeof(Element);
+        bytes = ((bytes + ALIGN - 1) & ~(ALIGN - 1)) + TAG;
+        if(bytes < MIN_FREE)
+            bytes = MIN_FREE;
 
-        Element * e = search_decrementing(bytes);
+        Element * e = head();
+        for(; e && (e->size() != bytes) && (e->size() < bytes + MIN_FREE); e = e->next());
         if(!e) {
             out_of_memory(bytes);
             return 0;
         }
 
-        long * addr = reinterpret_cast<long *>(e->object() + e->size());
+        char * block;
+        if(e->size() == bytes) {
+            remove(e);
+            block = e->object();
+            tag(block) |= USED;
+        } else {
+            e->shrink(bytes);
+            tag(e->object()) = e->size() | (tag(e->object()) & PREV_USED);
+            footer(e->object(), e->size()) = e->size();
+            block = e->object() + e->size();
+            tag(block) = bytes | USED;
+        }
+        tag(block + bytes) |= PREV_USED;
+        _grouped_size -= bytes;
 
+        long * addr = reinterpret_cast<long *>(block + TAG);
         if(typed)
             *addr++ = reinterpret_cast<long>(this);
-        *addr++ = bytes;
 
         db<Heaps>(TRC) << ") => " << reinterpret_cast<void *>(addr) << endl;
 
         return addr;
     }
 
+    // Adds a region of memory to the heap
     void free(void * ptr, unsigned long bytes) {
         db<Heaps>(TRC) << "Heap::free(this=" << this << ",ptr=" << ptr << ",bytes=" << bytes << ")" << endl;
 
-        if(ptr && (bytes >= sizeof(Element))) {
-            Element * e = new (ptr) Element(reinterpret_cast<char *>(ptr), bytes);
-            Element * m1, * m2;
-            insert_merging(e, &m1, &m2);
-        }
+        char * addr = reinterpret_cast<char *>((reinterpret_cast<unsigned long>(ptr) + ALIGN - 1) & ~(ALIGN - 1));
+        if(!ptr || (bytes < static_cast<unsigned long>(addr - reinterpret_cast<char *>(ptr)) + MIN_FREE + TAG))
+            return;
+        bytes = (bytes - (addr - reinterpret_cast<char *>(ptr)) - TAG) & ~(ALIGN - 1);
+
+        tag(addr + bytes) = USED; // sentinel
+        tag(addr) = bytes | PREV_USED | USED;
+        release(addr);
     }
 
     static void typed_free(void * ptr) {
         long * addr = reinterpret_cast<long *>(ptr);
-        unsigned long bytes = *--addr;
         Heap_Imp * heap = reinterpret_cast<Heap_Imp *>(*--addr);
-        heap->free(addr, bytes);
+        heap->release(reinterpret_cast<char *>(addr) - TAG);
     }
 
     static void untyped_free(Heap_Imp * heap, void * ptr) {
+        heap->release(reinterpret_cast<char *>(ptr) - TAG);
+    }
+
+    // The heap a block of a typed heap came from
+    static Heap_Imp * owner(void * ptr) { return reinterpret_cast<Heap_Imp *>(reinterpret_cast<long *>(ptr)[-1]); }
+
+private:
+    static unsigned long & tag(char * block) { return *reinterpret_cast<unsigned long *>(block); }
+    static unsigned long & footer(char * block, unsigned long size) { return *reinterpret_cast<unsigned long *>(block + size - sizeof(long)); }
+    static Element * element(char * block) { return reinterpret_cast<Element *>(block + TAG); }
+
+    void release(char * block) {
+        unsigned long bytes = tag(block) & ~FLAGS;
+
+        db<Heaps>(TRC) << "Heap::free(this=" << this << ",ptr=" << reinterpret_cast<void *>(block + TAG) << ",bytes=" << bytes << ")" << endl;
+
+        _grouped_size += bytes;
+
+        char * next = block + bytes;
+        if(!(tag(next) & USED)) {
+            Element * r = element(next);
+            bytes += r->size();
+            remove(r);
+        }
+
+        if(!(tag(block) & PREV_USED)) {
+            char * prev = block - footer(block, 0);
+            Element * l = element(prev);
+            l->expand(bytes);
+            block = prev;
+            bytes = l->size();
+        } else
+            insert_tail(new (element(block)) Element(block, bytes));
+
+        tag(block) = bytes | PREV_USED;
+        footer(block, bytes) = bytes;
+        tag(block + bytes) &= ~PREV_USED;
+    }
+
+    void out_of_memory(unsigned long bytes);
+
+private:
+    unsigned long _grouped_size;
+};
+
+
+// Two-Level Segregated Fit Heap (TLSF)
+// Free blocks are kept in lists by size, in SL_COUNT classes of equal width within each power of two, and a two-level
+// bitmap tells which lists have blocks. Allocations take the head of the first list whose blocks all fit, so no list is
+// ever searched, and give the rest of the block back when it is large enough for a block of its own. Blocks carry
+// boundary tags (their size, whether they and the block before them are free and, if so, where that one starts), so
+// free blocks are merged with both neighbors in constant time as well. Each region handed to free(addr, bytes) ends in a
+// used sentinel, so blocks are never merged across regions.
+class TLSF_Heap
+{
+protected:
+    static const bool typed = Traits<System>::multiheap;
+
+private:
+    static const unsigned long ALIGN = sizeof(void *);
+    static const unsigned int ALIGN_LOG2 = (sizeof(void *) == 8) ? 3 : 2;
+    static const unsigned int SL_LOG2 = 4;
+    static const unsigned int SL_COUNT = 1 << SL_LOG2;
+    static const unsigned int FL_SHIFT = SL_LOG2 + ALIGN_LOG2;  // sizes below 2^FL_SHIFT all go to the first level
+    static const unsigned int FL_MAX = 30;                      // blocks are smaller than 2^FL_MAX bytes
+    static const unsigned int FL_COUNT = FL_MAX - FL_SHIFT + 1;
+    static const unsigned long SMALL = 1UL << FL_SHIFT;
+    static const unsigned long MAX_REGION = 1UL << (FL_MAX - 1);
+
+    static const unsigned long FREE = 1;
+    static const unsigned long PREV_FREE = 2;
+    static const unsigned long FLAGS = FREE | PREV_FREE;
+
+    // Only the first two fields are kept in used blocks, whose payload starts at "next_free"
+    struct Block {
+        Block * prev;               // the block right before this one, valid only while that one is free
+        unsigned long tag;          // size, header included, | flags
+        Block * next_free;
+        Block * prev_free;
+
+        unsigned long size() const { return tag & ~FLAGS; }
+        bool free() const { return tag & FREE; }
+        Block * next() { return reinterpret_cast<Block *>(reinterpret_cast<char *>(this) + size()); }
+        void * payload() { return &next_free; }
+    };
+
+    static const unsigned long HEADER = sizeof(Block *) + sizeof(unsigned long);
+    static const unsigned long MIN_BLOCK = sizeof(Block);
+
+public:
+    TLSF_Heap(): _size(0), _grouped_size(0) {
+        db<Init, Heaps>(TRC) << "Heap() => " << this << endl;
+
+        for(unsigned int i = 0; i < FL_COUNT; i++)
+            for(unsigned int j = 0; j < SL_COUNT; j++)
+                _list[i][j] = 0;
+    }
+
+    TLSF_Heap(void * addr, unsigned long bytes): TLSF_Heap() {
+        db<Init, Heaps>(TRC) << "Heap(addr=" << addr << ",bytes=" << bytes << ") => " << this << endl;
+
+        free(addr, bytes);
+    }
+
+    bool empty() const { return !_size; }
+    unsigned long size() const { return _size; }                 // free blocks
+    unsigned long grouped_size() const { return _grouped_size; } // free bytes, headers included
+
+    void * alloc(unsigned long bytes) {
+        db<Heaps>(TRC) << "Heap::alloc(this=" << this << ",bytes=" << bytes;
+
+        if(!bytes)
+            return 0;
+
+        if(typed)
+            bytes += sizeof(void *); // add room for heap pointer
+        unsigned long size = ((bytes + ALIGN - 1) & ~(ALIGN - 1)) + HEADER;
+        if(size < MIN_BLOCK)
+            size = MIN_BLOCK;
+
+        unsigned int fl, sl;
+        Block * b = (size < MAX_REGION) ? find(size, &fl, &sl) : 0;
+        if(!b) {
+            out_of_memory(bytes);
+            return 0;
+        }
+        remove(b, fl, sl);
+
+        // Split off whatever is left, if it makes a block
+        if(b->size() - size >= MIN_BLOCK) {
+            Block * r = reinterpret_cast<Block *>(reinterpret_cast<char *>(b) + size);
+            r->tag = (b->size() - size) | FREE;
+            r->next()->prev = r;
+            b->tag = size | (b->tag & PREV_FREE);
+            insert(r);
+        } else
+            b->next()->tag &= ~PREV_FREE;
+        b->tag &= ~FREE;
+
+        long * addr = reinterpret_cast<long *>(b->payload());
+        if(typed)
+            *addr++ = reinterpret_cast<long>(this);
+
+        db<Heaps>(TRC) << ") => " << reinterpret_cast<void *>(addr) << endl;
+
+        return addr;
+    }
+
+    // Adds a region of memory to the heap
+    void free(void * ptr, unsigned long bytes) {
+        db<Heaps>(TRC) << "Heap::free(this=" << this << ",ptr=" << ptr << ",bytes=" << bytes << ")" << endl;
+
+        char * addr = reinterpret_cast<char *>((reinterpret_cast<unsigned long>(ptr) + ALIGN - 1) & ~(ALIGN - 1));
+        if(!ptr || (bytes < static_cast<unsigned long>(addr - reinterpret_cast<char *>(ptr)) + MIN_BLOCK + HEADER))
+            return;
+        bytes = (bytes - (addr - reinterpret_cast<char *>(ptr))) & ~(ALIGN - 1);
+
+        while(bytes >= MIN_BLOCK + HEADER) {
+            unsigned long chunk = (bytes > MAX_REGION) ? MAX_REGION : bytes;
+            Block * b = reinterpret_cast<Block *>(addr);
+            b->tag = (chunk - HEADER) | FREE;
+            Block * sentinel = b->next();
+            sentinel->prev = b;
+            sentinel->tag = PREV_FREE;
+            insert(b);
+            addr += chunk;
+            bytes -= chunk;
+        }
+    }
+
+    static void typed_free(void * ptr) {
         long * addr = reinterpret_cast<long *>(ptr);
-        unsigned long bytes = *--addr;
-        heap->free(addr, bytes);
+        TLSF_Heap * heap = reinterpret_cast<TLSF_Heap *>(*--addr);
+        heap->release(block(addr));
     }
 
+    static void untyped_free(TLSF_Heap * heap, void * ptr) {
+        heap->release(block(ptr));
+    }
+
+    // The heap a block of a typed heap came from
+    static TLSF_Heap * owner(void * ptr) { return reinterpret_cast<TLSF_Heap *>(reinterpret_cast<long *>(ptr)[-1]); }
+
 private:
+    static Block * block(void * payload) { return reinterpret_cast<Block *>(reinterpret_cast<char *>(payload) - HEADER); }
+
+    static unsigned int msb(unsigned long size) { return sizeof(unsigned long) * 8 - 1 - __builtin_clzl(size); }
+
+    // The class a block of "size" bytes belongs to
+    static void classify(unsigned long size, unsigned int * fl, unsigned int * sl) {
+        if(size < SMALL) {
+            *fl = 0;
+            *sl = size >> ALIGN_LOG2;
+        } else {
+            unsigned int m = msb(size);
+            *fl = m - FL_SHIFT + 1;
+            *sl = (size >> (m - SL_LOG2)) - SL_COUNT;
+        }
+    }
+
+    // The head of the first non-empty class at or above the one whose blocks are all at least "size" bytes long or,
+    // failing that, the head of the class of "size" itself, if it happens to fit
+    Block * find(unsigned long size, unsigned int * fl, unsigned int * sl) {
+        unsigned long rounded = (size >= SMALL) ? size + (1UL << (msb(size) - SL_LOG2)) - 1 : size;
+        classify(rounded, fl, sl);
+
+        int s = _sl[*fl].test(*sl) ? int(*sl) : _sl[*fl].first_after(*sl);
+        if(s < 0) {
+            int f = _fl.first_after(*fl);
+            if(f >= 0) {
+                *fl = f;
+                s = _sl[f].first();
+            }
+        }
+        if(s >= 0) {
+            *sl = s;
+            return _list[*fl][*sl];
+        }
+
+        classify(size, fl, sl);
+        Block * b = _list[*fl][*sl];
+        return (b && (b->size() >= size)) ? b : 0;
+    }
+
+    void insert(Block * b) {
+        unsigned int fl, sl;
+        classify(b->size(), &fl, &sl);
+
+        Block * head = _list[fl][sl];
+        b->prev_free = 0;
+        b->next_free = head;
+        if(head)
+            head->prev_free = b;
+        _list[fl][sl] = b;
+        _fl.set(fl);
+        _sl[fl].set(sl);
+
+        _size++;
+        _grouped_size += b->size();
+    }
+
+    void remove(Block * b, unsigned int fl, unsigned int sl) {
+        if(b->prev_free)
+            b->prev_free->next_free = b->next_free;
+        else {
+            _list[fl][sl] = b->next_free;
+            if(!b->next_free) {
+                _sl[fl].reset(sl);
+                if(_sl[fl].empty())
+                    _fl.reset(fl);
+            }
+        }
+        if(b->next_free)
+            b->next_free->prev_free = b->prev_free;
+
+        _size--;
+        _grouped_size -= b->size();
+    }
+
+    void remove(Block * b) {
+        unsigned int fl, sl;
+        classify(b->size(), &fl, &sl);
+        remove(b, fl, sl);
+    }
+
+    void release(Block * b) {
+        db<Heaps>(TRC) << "Heap::free(this=" << this << ",ptr=" << b->payload() << ",bytes=" << b->size() << ")" << endl;
+
+        b->tag |= FREE;
+
+        if(b->tag & PREV_FREE) {
+            Block * p = b->prev;
+            remove(p);
+            p->tag += b->size();
+            b = p;
+        }
+
+        Block * n = b->next();
+        if(n->free()) {
+            remove(n);
+            b->tag += n->size();
+            n = b->next();
+        }
+        n->prev = b;
+        n->tag |= PREV_FREE;
+
+        insert(b);
+    }
+
     void out_of_memory(unsigned long bytes);
+
+private:
+    Block * _list[FL_COUNT][SL_COUNT];
+    Bitmap<FL_COUNT> _fl;
+    Bitmap<SL_COUNT> _sl[FL_COUNT];
+    unsigned long _size;
+    unsigned long _grouped_size;
 };
 
 
@@ -102,14 +422,37 @@ public:
 
 
 // Wrapper for atomic heap
+// Blocks of up to MIN_CLASS << (CLASSES - 1) bytes are served from per-CPU magazines of MAGAZINE blocks of each size
+// class, refilled from and flushed to the heap BATCH blocks at a time, so most allocations and frees neither take
+// _heap_lock nor search the heap. Each block starts with a word telling its class and the CPU whose magazines it belongs
+// to. Blocks freed on other CPUs are pushed onto their CPU's remote list without locks, and that CPU takes the whole list
+// at once when a magazine runs dry. Blocks sitting in magazines count as allocated for the heap underneath.
 extern Simple_Spin _heap_lock;
 
 template<typename T>
 class Heap_Wrapper<T, true>: public T
 {
+private:
+    static const unsigned int CPUS = Traits<Build>::CPUS;
+    static const unsigned int ROUNDS = Traits<Heaps>::MAGAZINE;
+    static const unsigned int BATCH = (ROUNDS + 1) / 2;
+    static const unsigned int CLASSES = 5;
+    static const unsigned long MIN_CLASS = 16;      // bytes
+    static const unsigned long LARGE = CLASSES;     // class of blocks that bypass the magazines
+    static const unsigned int CPU_SHIFT = 8;
+
+    struct alignas(Traits<CPU>::CACHE_LINE_SIZE) Magazines {
+        unsigned int count[CLASSES];
+        long * rounds[CLASSES][ROUNDS ? ROUNDS : 1];
+    };
+
+    struct alignas(Traits<CPU>::CACHE_LINE_SIZE) Remote {
+        long * volatile head;
+    };
+
 public:
-    Heap_Wrapper() {}
-    Heap_Wrapper(void * addr, unsigned int bytes): T(addr, bytes) {}
+    Heap_Wrapper() { init(); }
+    Heap_Wrapper(void * addr, unsigned int bytes): T(addr, bytes) { init(); }
 
     bool empty() {
         enter();
@@ -126,16 +469,34 @@ public:
     }
 
     void * alloc(unsigned long bytes) {
-        enter();
-        void * tmp = T::alloc(bytes);
-        leave();
-        return tmp;
+        if(!bytes)
+            return 0;
+
+        long * raw;
+        unsigned int c = size_class(bytes);
+        if(c == LARGE) {
+            enter();
+            raw = reinterpret_cast<long *>(T::alloc(sizeof(long) + bytes));
+            leave();
+            if(raw)
+                *raw = LARGE;
+        } else {
+            bool disabled = CPU::int_disabled();
+            CPU::int_disable();
+            unsigned int cpu = CPU::id();
+            Magazines & m = _magazines[cpu];
+            if(!m.count[c])
+                refill(cpu, c);
+            raw = m.count[c] ? m.rounds[c][--m.count[c]] : 0;
+            if(!disabled)
+                CPU::int_enable();
+        }
+
+        return raw ? raw + 1 : 0;
     }
 
     void free(void * ptr) {
-        enter();
-        T::free(ptr);
-        leave();
+        put(reinterpret_cast<long *>(ptr) - 1);
     }
 
     void free(void * ptr, unsigned long bytes) {
@@ -144,13 +505,121 @@ public:
         leave();
     }
 
+    static void typed_free(void * ptr) {
+        long * raw = reinterpret_cast<long *>(ptr) - 1;
+        static_cast<Heap_Wrapper *>(T::owner(raw))->put(raw);
+    }
+
+    static void untyped_free(Heap_Wrapper * heap, void * ptr) {
+        heap->put(reinterpret_cast<long *>(ptr) - 1);
+    }
+
 private:
+    void init() {
+        for(unsigned int i = 0; i < CPUS; i++) {
+            for(unsigned int c = 0; c < CLASSES; c++)
+                _magazines[i].count[c] = 0;
+            _remote[i].head = 0;
+        }
+    }
+
+    static unsigned int size_class(unsigned long bytes) {
+        if(!ROUNDS)
+            return LARGE;
+        unsigned int c = 0;
+        while((c < CLASSES) && (bytes > (MIN_CLASS << c)))
+            c++;
+        return c;
+    }
+
+    void put(long * raw) {
+        unsigned int c = *raw & ((1UL << CPU_SHIFT) - 1);
+        if(c == LARGE) {
+            enter();
+            release(raw);
+            leave();
+            return;
+        }
+
+        bool disabled = CPU::int_disabled();
+        CPU::int_disable();
+        unsigned int cpu = CPU::id();
+        unsigned int home = *raw >> CPU_SHIFT;
+        if(home == cpu)
+            cache(cpu, raw);
+        else {
+            long * head;
+            do {
+                head = _remote[home].head;
+                raw[1] = reinterpret_cast<long>(head);
+            } while(CPU::cas(_remote[home].head, head, raw) != head);
+        }
+        if(!disabled)
+            CPU::int_enable();
+    }
+
+    // The following run on "cpu" with interrupts disabled
+    void cache(unsigned int cpu, long * raw) {
+        unsigned int c = *raw & ((1UL << CPU_SHIFT) - 1);
+        Magazines & m = _magazines[cpu];
+        if(m.count[c] == ROUNDS)
+            flush(cpu, c);
+        m.rounds[c][m.count[c]++] = raw;
+    }
+
+    void refill(unsigned int cpu, unsigned int c) {
+        // Blocks freed by other CPUs come first, and only one thief at a time empties the list, so there is no ABA
+        long * list;
+        do
+            list = _remote[cpu].head;
+        while(CPU::cas(_remote[cpu].head, list, static_cast<long *>(0)) != list);
+        while(list) {
+            long * next = reinterpret_cast<long *>(list[1]);
+            cache(cpu, list);
+            list = next;
+        }
+
+        Magazines & m = _magazines[cpu];
+        if(m.count[c])
+            return;
+
+        enter();
+        for(unsigned int i = 0; i < BATCH; i++) {
+            long * raw = reinterpret_cast<long *>(T::alloc(sizeof(long) + (MIN_CLASS << c)));
+            if(!raw)
+                break;
+            *raw = (cpu << CPU_SHIFT) | c;
+            m.rounds[c][m.count[c]++] = raw;
+        }
+        leave();
+    }
+
+    void flush(unsigned int cpu, unsigned int c) {
+        Magazines & m = _magazines[cpu];
+        enter();
+        for(unsigned int i = 0; i < BATCH; i++)
+            release(m.rounds[c][--m.count[c]]);
+        leave();
+    }
+
+    void release(long * raw) {
+        if(T::typed)
+            T::typed_free(raw);
+        else
+            T::untyped_free(this, raw);
+    }
+
     void enter() { _heap_lock.acquire(); }
     void leave() { _heap_lock.release(); }
+
+private:
+    Magazines _magazines[CPUS];
+    Remote _remote[CPUS];
 };
 
 
-typedef Heap_Wrapper<Heap_Imp, Traits<System>::multicore> Heap;
+typedef IF<Traits<Heaps>::ALLOCATOR == Traits<Heaps>::TLSF, TLSF_Heap, Heap_Imp>::Result Heap_Allocator;
+typedef Heap_Wrapper<Heap_Allocator, Traits<System>::multicore> Heap;
 
 __END_UTIL
 
@@ -4,6 +4,7 @@
 #define __list_h
 
 #include <system/config.h>
+#include "bitmap.h"
 
 __BEGIN_UTIL
 
@@ -261,6 +262,87 @@ namespace List_Elements
     };
 
 
+    // Scheduling Bitmap Element
+    // Behaves as a Doubly_Linked_Scheduling element while in a list. While in a
+    // bitmap-indexed list, _level keeps the level it was inserted at, so the
+    // element can be removed after its rank has changed.
+    template<typename T, typename R = Rank>
+    class Doubly_Linked_Scheduling_Bitmap
+    {
+    public:
+        typedef T Object_Type;
+        typedef R Rank_Type;
+        typedef Doubly_Linked_Scheduling_Bitmap Element;
+
+    public:
+        Doubly_Linked_Scheduling_Bitmap(const T * o,  const R & r = 0): _object(o), _rank(r), _prev(0), _next(0), _level(0) {}
+
+        T * object() const { return const_cast<T *>(_object); }
+
+        Element * prev() const { return _prev; }
+        Element * next() const { return _next; }
+        void prev(Element * e) { _prev = e; }
+        void next(Element * e) { _next = e; }
+
+        const R & rank() const { return _rank; }
+        void rank(const R & r) { _rank = r; }
+        int promote(const R & n = 1) { _rank -= n; return _rank; }
+        int demote(const R & n = 1) { _rank += n; return _rank; }
+
+        unsigned int level() const { return _level; }
+        void level(unsigned int l) { _level = l; }
+
+    private:
+        const T * _object;
+        R _rank;
+        Element * _prev;
+        Element * _next;
+        unsigned int _level;
+    };
+
+
+    // Scheduling Heap Element
+    // Behaves as a Doubly_Linked_Scheduling element while in a list. While in a
+    // pairing heap, _next links siblings, _prev points to the left sibling (or
+    // to the parent, for the leftmost child) and _child to the leftmost child.
+    template<typename T, typename R = Rank>
+    class Doubly_Linked_Scheduling_Heap
+    {
+    public:
+        typedef T Object_Type;
+        typedef R Rank_Type;
+        typedef Doubly_Linked_Scheduling_Heap Element;
+
+    public:
+        Doubly_Linked_Scheduling_Heap(const T * o,  const R & r = 0): _object(o), _rank(r), _prev(0), _next(0), _child(0), _order(0) {}
+
+        T * object() const { return const_cast<T *>(_object); }
+
+        Element * prev() const { return _prev; }
+        Element * next() const { return _next; }
+        Element * child() const { return _child; }
+        void prev(Element * e) { _prev = e; }
+        void next(Element * e) { _next = e; }
+        void child(Element * e) { _child = e; }
+
+        const R & rank() const { return _rank; }
+        void rank(const R & r) { _rank = r; }
+        int promote(const R & n = 1) { _rank -= n; return _rank; }
+        int demote(const R & n = 1) { _rank += n; return _rank; }
+
+        unsigned long order() const { return _order; }
+        void order(unsigned long o) { _order = o; }
+
+    private:
+        const T * _object;
+        R _rank;
+        Element * _prev;
+        Element * _next;
+        Element * _child;
+        unsigned long _order;
+    };
+
+
     // Grouping List Element
     template<typename T>
     class Doubly_Linked_Grouping
@@ -1024,6 +1106,300 @@ template<typename T,
 class Relative_List: public Ordered_List<T, R, El, true> {};
 
 
+// Doubly-Linked, Hierarchical Timing Wheel
+// Elements are ranked by the absolute tick at which they expire and kept in
+// LEVELS wheels of 2^BITS slots each, a slot of level l spanning 2^(BITS * l)
+// ticks, so insertion and removal take constant time. As time advances, the
+// slots reached in the upper levels are cascaded into the lower ones and the
+// elements in the level-0 slots reached are moved to the expired list, from
+// which remove() takes them in expiration order (FIFO among equals). Elements
+// expiring farther than 2^(BITS * LEVELS) ticks ahead are parked in the top
+// level and reinserted as their slot comes around. Each slot is a circular
+// list around a sentinel element (whose object is null), so an element can be
+// removed without knowing where it is. Ranks are compared by their differences,
+// so they may wrap around.
+template<typename T,
+          typename R = List_Element_Rank,
+          typename El = List_Elements::Doubly_Linked_Ordered<T, R>,
+          unsigned int BITS = 6,
+          unsigned int LEVELS = 4>
+class Timing_Wheel
+{
+private:
+    static const unsigned int SLOTS = 1 << BITS;
+    static const unsigned int MASK = SLOTS - 1;
+    static const unsigned long HORIZON = 1UL << (BITS * LEVELS);
+    static const unsigned int EXPIRED = LEVELS * SLOTS;
+
+    struct Sentinel: public El { Sentinel(): El(0) {} };
+
+public:
+    typedef T Object_Type;
+    typedef R Rank_Type;
+    typedef El Element;
+
+public:
+    Timing_Wheel(): _now(0), _size(0) {
+        for(unsigned int i = 0; i <= EXPIRED; i++) {
+            _slot[i].prev(&_slot[i]);
+            _slot[i].next(&_slot[i]);
+        }
+    }
+
+    bool empty() const { return !_size; }
+    unsigned long size() const { return _size; }
+
+    const R & now() const { return _now; }
+
+    bool expired() { return _slot[EXPIRED].next() != &_slot[EXPIRED]; }
+
+    void insert(Element * e) {
+        db<Lists>(TRC) << "Timing_Wheel::insert(e=" << e << ",r=" << e->rank() << ") => {now=" << _now << "}" << endl;
+
+        _size++;
+        place(e);
+    }
+
+    Element * remove(Element * e) {
+        db<Lists>(TRC) << "Timing_Wheel::remove(e=" << e << ",r=" << e->rank() << ")" << endl;
+
+        if(!e->next()) // not in the wheel
+            return 0;
+
+        _size--;
+        Element * prev = e->prev();
+        prev->next(e->next());
+        e->next()->prev(prev);
+        e->prev(0);
+        e->next(0);
+
+        if(!prev->object() && (prev->next() == prev)) { // the slot became empty
+            unsigned int i = static_cast<Sentinel *>(prev) - _slot;
+            if(i != EXPIRED)
+                _map[i / SLOTS].reset(i % SLOTS);
+        }
+
+        return e;
+    }
+
+    // Removes the next expired element (0 if none)
+    Element * remove() {
+        Element * e = _slot[EXPIRED].next();
+        return (e != &_slot[EXPIRED]) ? remove(e) : 0;
+    }
+
+    // Tick at which the next non-empty slot is reached (false if the wheel has none)
+    bool next(R * tick) {
+        bool found = false;
+        for(unsigned int l = 0; l < LEVELS; l++) {
+            unsigned int current = index(l, _now);
+            int s = _map[l].first_after(current);
+            if(s < 0)
+                s = _map[l].first();
+            if(s < 0)
+                continue;
+            unsigned long distance = (s - current) & MASK;
+            if(!distance) // the current slot was handled when it was reached, so it only counts after a full turn
+                distance = SLOTS;
+            R t = ((static_cast<unsigned long>(_now) >> (BITS * l)) + distance) << (BITS * l);
+            if(!found || (R(t - *tick) < 0)) {
+                *tick = t;
+                found = true;
+            }
+        }
+        return found;
+    }
+
+    // Moves time forward up to "tick", moving every element that expires until then to the expired list
+    void advance(const R & tick) {
+        R t = 0;
+        while(next(&t) && (R(tick - t) >= 0)) {
+            _now = t;
+
+            for(unsigned int l = LEVELS - 1; l > 0; l--)
+                if(!(static_cast<unsigned long>(_now) & ((1UL << (BITS * l)) - 1)))
+                    cascade(l * SLOTS + index(l, _now));
+
+            cascade(index(0, _now));
+        }
+        _now = tick;
+    }
+
+private:
+    static unsigned int index(unsigned int level, const R & tick) {
+        return (static_cast<unsigned long>(tick) >> (BITS * level)) & MASK;
+    }
+
+    void place(Element * e) {
+        R delta = e->rank() - _now;
+
+        unsigned int i;
+        if(delta <= 0)
+            i = EXPIRED;
+        else {
+            unsigned int l = 0;
+            while((l < LEVELS - 1) && (static_cast<unsigned long>(delta) >= (1UL << (BITS * (l + 1)))))
+                l++;
+            R tick = (static_cast<unsigned long>(delta) < HORIZON) ? e->rank() : R(_now + HORIZON - 1);
+            i = l * SLOTS + index(l, tick);
+            _map[l].set(index(l, tick));
+        }
+
+        Element * tail = _slot[i].prev();
+        e->prev(tail);
+        e->next(&_slot[i]);
+        tail->next(e);
+        _slot[i].prev(e);
+    }
+
+    // Empties a slot, placing its elements again (those expiring now go to the expired list)
+    void cascade(unsigned int i) {
+        Element * e = _slot[i].next();
+        _slot[i].prev(&_slot[i]);
+        _slot[i].next(&_slot[i]);
+        _map[i / SLOTS].reset(i % SLOTS);
+
+        while(e != &_slot[i]) {
+            Element * next = e->next();
+            place(e);
+            e = next;
+        }
+    }
+
+private:
+    R _now;
+    unsigned long _size;
+    Sentinel _slot[EXPIRED + 1];
+    Bitmap<SLOTS> _map[LEVELS];
+};
+
+
+// Doubly-Linked, Bitmap-Indexed Ordered List
+// An ordered list in which ranks are grouped in LEVELS levels whose last
+// elements are indexed by a bitmap, so an insertion does not need to walk the
+// list to find its place. Ranks in [0, LEVELS - 6] get a level of their own
+// and are inserted in constant time (FIFO among equals). NORMAL and IDLE also
+// get their own levels, while the few ranks in between share the remaining
+// levels and are ordered within them. R must export NORMAL and IDLE.
+// Elements must be Doubly_Linked_Scheduling_Bitmap (or compatible), whose
+// level is recorded on insertion, so ranks may change while in the list as
+// long as the element is removed (or updated) before it is compared again.
+template<typename T,
+          typename R = List_Element_Rank,
+          typename El = List_Elements::Doubly_Linked_Scheduling_Bitmap<T, R>,
+          unsigned int LEVELS = 256>
+class Bitmap_Ordered_List: public List<T, El>
+{
+private:
+    typedef List<T, El> Base;
+
+public:
+    typedef T Object_Type;
+    typedef R Rank_Type;
+    typedef El Element;
+    typedef List_Iterators::Bidirecional<El> Iterator;
+
+public:
+    Bitmap_Ordered_List() {
+        for(unsigned int i = 0; i < LEVELS; i++)
+            _tail[i] = 0;
+    }
+
+    using Base::empty;
+    using Base::size;
+    using Base::head;
+    using Base::tail;
+    using Base::begin;
+    using Base::end;
+    using Base::search;
+
+    void insert(Element * e) {
+        db<Lists>(TRC) << "Bitmap_Ordered_List::insert(e=" << e
+                       << ") => {p=" << (e ? e->prev() : (void *) -1)
+                       << ",o=" << (e ? e->object() : (void *) -1)
+                       << ",n=" << (e ? e->next() : (void *) -1)
+                       << "}" << endl;
+
+        unsigned int l = level(e->rank());
+        e->level(l);
+
+        Element * prev = _tail[l];
+        if(prev) { // only shared levels will actually walk
+            for(; prev && (prev->rank() > e->rank()) && (prev->level() == l); prev = prev->prev());
+        } else {
+            int previous = _levels.last_before(l);
+            prev = (previous >= 0) ? _tail[previous] : 0;
+        }
+
+        if(!prev)
+            Base::insert_head(e);
+        else if(!prev->next())
+            Base::insert_tail(e);
+        else
+            Base::insert(e, prev, prev->next());
+
+        if(!e->next() || (e->next()->level() != l))
+            _tail[l] = e;
+        _levels.set(l);
+    }
+
+    Element * remove() { return remove_head(); }
+
+    Element * remove(Element * e) {
+        db<Lists>(TRC) << "Bitmap_Ordered_List::remove(e=" << e
+                       << ") => {p=" << (e ? e->prev() : (void *) -1)
+                       << ",o=" << (e ? e->object() : (void *) -1)
+                       << ",n=" << (e ? e->next() : (void *) -1)
+                       << "}" << endl;
+
+        unsigned int l = e->level();
+        if(_tail[l] == e) {
+            if(e->prev() && (e->prev()->level() == l))
+                _tail[l] = e->prev();
+            else {
+                _tail[l] = 0;
+                _levels.reset(l);
+            }
+        }
+
+        return Base::remove(e);
+    }
+
+    Element * remove(const Object_Type * obj) {
+        Element * e = search(obj);
+        if(e)
+            return remove(e);
+        return 0;
+    }
+
+    Element * remove_head() {
+        Element * e = head();
+        if(e)
+            remove(e);
+        return e;
+    }
+
+private:
+    static unsigned int level(int rank) {
+        if(rank < 0)
+            return 0;
+        if(rank <= int(LEVELS - 6))
+            return rank + 1;
+        if(rank < R::NORMAL)
+            return LEVELS - 4;
+        if(rank == R::NORMAL)
+            return LEVELS - 3;
+        if(rank < R::IDLE)
+            return LEVELS - 2;
+        return LEVELS - 1;
+    }
+
+private:
+    Element * _tail[LEVELS];
+    Bitmap<LEVELS> _levels;
+};
+
+
 // Doubly-Linked, Typed List
 template<typename T = void,
           typename R = List_Element_Rank,
@@ -1039,8 +1415,9 @@ class Typed_List: public List<T, El> {};
 // referenced by the _chosen attribute.
 template<typename T,
           typename R = typename T::Criterion,
-          typename El = List_Elements::Doubly_Linked_Scheduling<T, R> >
-class Scheduling_List: private Ordered_List<T, R, El>
+          typename El = List_Elements::Doubly_Linked_Scheduling<T, R>,
+          typename B = Ordered_List<T, R, El> >
+class Scheduling_List: private B
 {
     template<typename FT, typename FR, typename FEl, unsigned int FH>
     friend class Multihead_Scheduling_List;     // for chosen() and remove()
@@ -1048,7 +1425,7 @@ class Scheduling_List: private Ordered_List<T, R, El>
     friend class Scheduling_Multilist;          // for chosen() and remove()
 
 private:
-    typedef Ordered_List<T, R, El> Base;
+    typedef B Base;
 
 public:
     typedef T Object_Type;
@@ -1134,6 +1511,15 @@ public:
         return _chosen;
     }
 
+    void update(Element * e) {
+        db<Lists>(TRC) << "Scheduling_List::update(e=" << e << ")" << endl;
+
+        if(e != _chosen) {
+            Base::remove(e);
+            Base::insert(e);
+        }
+    }
+
 private:
     using Base::remove;
     void chosen(Element * e) { _chosen = e; }
@@ -1143,6 +1529,235 @@ private:
 };
 
 
+// Doubly-Linked, Bitmap-Indexed Scheduling List
+// A Scheduling_List whose insertions take constant time for the usual static
+// priorities (see Bitmap_Ordered_List). Ranks changed while queued must be
+// followed by update(), which, as for any other rank, walks shared levels.
+template<typename T,
+          typename R = typename T::Criterion,
+          typename El = List_Elements::Doubly_Linked_Scheduling_Bitmap<T, R> >
+class Bitmap_Scheduling_List: public Scheduling_List<T, R, El, Bitmap_Ordered_List<T, R, El> > {};
+
+
+// Pairing-Heap Scheduling List
+// A scheduling list for dynamic criteria kept as an intrusive pairing heap,
+// so insertions and rank updates do not walk the ready queue: insert() is
+// O(1) and removals and update() are O(log n) amortized. Ties are broken by
+// insertion order, so objects with the same rank are still chosen in FIFO
+// order. As in Scheduling_List, the chosen element is kept outside the heap.
+// Elements must be Doubly_Linked_Scheduling_Heap (or compatible) and
+// update() must be invoked whenever the rank of a queued object changes.
+template<typename T,
+          typename R = typename T::Criterion,
+          typename El = List_Elements::Doubly_Linked_Scheduling_Heap<T, R> >
+class Heap_Scheduling_List
+{
+    template<typename FT, typename FR, typename FEl, typename FL, unsigned int FQ>
+    friend class Scheduling_Multilist;          // for chosen() and remove()
+
+public:
+    typedef T Object_Type;
+    typedef R Rank_Type;
+    typedef El Element;
+    typedef List_Iterators::Bidirecional<El> Iterator;
+
+public:
+    Heap_Scheduling_List(): _chosen(0), _root(0), _size(0), _order(0) {}
+
+    bool empty() const { return !_size; }
+    unsigned long size() const { return _size; }
+
+    Element * head() { return _root; }
+
+    Element * volatile & chosen() { return _chosen; }
+
+    void insert(Element * e) {
+        db<Lists>(TRC) << "Heap_Scheduling_List::insert(e=" << e << ")" << endl;
+
+        if(_chosen)
+            push(e);
+        else
+            _chosen = e;
+    }
+
+    Element * remove(Element * e) {
+        db<Lists>(TRC) << "Heap_Scheduling_List::remove(e=" << e << ")" << endl;
+
+        if(e == _chosen)
+            _chosen = pop();
+        else
+            extract(e);
+
+        return e;
+    }
+
+    Element * choose() {
+        db<Lists>(TRC) << "Heap_Scheduling_List::choose()" << endl;
+
+        if(!empty()) {
+            push(_chosen);
+            _chosen = pop();
+        }
+
+        return _chosen;
+    }
+
+    Element * choose_another() {
+        db<Lists>(TRC) << "Heap_Scheduling_List::choose_another()" << endl;
+
+        if(!empty() && _root->rank() != R::IDLE) {
+            Element * tmp = _chosen;
+            _chosen = pop();
+            push(tmp);
+        }
+
+        return _chosen;
+    }
+
+    Element * choose(Element * e) {
+        db<Lists>(TRC) << "Heap_Scheduling_List::choose(e=" << e << ")" << endl;
+
+        if(e != _chosen) {
+            push(_chosen);
+            extract(e);
+            _chosen = e;
+        }
+
+        return _chosen;
+    }
+
+    // Restores the heap order after the rank of "e" changed. A rank decrease (i.e. e became more urgent) only cuts e's
+    // subtree and melds it with the root, while an increase also has to merge e's children.
+    void update(Element * e) {
+        db<Lists>(TRC) << "Heap_Scheduling_List::update(e=" << e << ")" << endl;
+
+        if(e == _chosen)
+            return;
+
+        if(e == _root)
+            _root = merge(e->child());
+        else {
+            cut(e);
+            Element * c;
+            for(c = e->child(); c && !before(c, e); c = c->next());
+            if(!c) { // decrease-key: e's subtree is still a heap
+                _root = meld(_root, e);
+                return;
+            }
+            _root = meld(_root, merge(e->child()));
+        }
+
+        e->child(0);
+        _root = meld(_root, e);
+    }
+
+private:
+    // Lower ranks first and FIFO among equal ranks (order wraps around safely)
+    static bool before(Element * a, Element * b) {
+        return (int(a->rank()) < int(b->rank())) || ((int(a->rank()) == int(b->rank())) && (long(a->order() - b->order()) < 0));
+    }
+
+    // Melds two detached heaps, returning the new root
+    static Element * meld(Element * a, Element * b) {
+        if(!a)
+            return b;
+        if(!b)
+            return a;
+        if(before(b, a)) {
+            Element * tmp = a;
+            a = b;
+            b = tmp;
+        }
+        b->prev(a);
+        b->next(a->child());
+        if(a->child())
+            a->child()->prev(b);
+        a->child(b);
+        return a;
+    }
+
+    // Two-pass pairing of a sibling list, returning the resulting heap
+    static Element * merge(Element * first) {
+        Element * pairs = 0;
+        while(first) {
+            Element * a = first;
+            Element * b = a->next();
+            first = b ? b->next() : 0;
+            a->prev(0);
+            a->next(0);
+            if(b) {
+                b->prev(0);
+                b->next(0);
+            }
+            a = meld(a, b);
+            a->next(pairs);
+            pairs = a;
+        }
+
+        Element * root = 0;
+        while(pairs) {
+            Element * next = pairs->next();
+            pairs->next(0);
+            root = meld(root, pairs);
+            pairs = next;
+        }
+
+        return root;
+    }
+
+    // Detaches a non-root element (and its subtree) from its parent or left sibling
+    void cut(Element * e) {
+        if(e->prev()->child() == e)
+            e->prev()->child(e->next());
+        else
+            e->prev()->next(e->next());
+        if(e->next())
+            e->next()->prev(e->prev());
+        e->prev(0);
+        e->next(0);
+    }
+
+    void push(Element * e) {
+        e->prev(0);
+        e->next(0);
+        e->child(0);
+        e->order(_order++);
+        _root = meld(_root, e);
+        _size++;
+    }
+
+    Element * pop() {
+        Element * e = _root;
+        if(e) {
+            _root = merge(e->child());
+            e->child(0);
+            _size--;
+        }
+        return e;
+    }
+
+    void extract(Element * e) {
+        if(e == _root)
+            pop();
+        else {
+            cut(e);
+            _root = meld(_root, merge(e->child()));
+            e->child(0);
+            _size--;
+        }
+    }
+
+    Element * remove() { return pop(); }
+    void chosen(Element * e) { _chosen = e; }
+
+private:
+    Element * volatile _chosen;
+    Element * _root;
+    unsigned long _size;
+    unsigned long _order;
+};
+
+
 // Doubly-Linked, Multihead Scheduling List
 // Besides declaring "Criterion", objects subject to scheduling policies that
 // use the Multihead list must export the HEADS constant to indicate the
@@ -1248,6 +1863,17 @@ public:
         return _chosen[R::current_head()];
     }
 
+    void update(Element * e) {
+        db<Lists>(TRC) << "Scheduling_List::update(e=" << e << ")" << endl;
+
+        for(unsigned int i = 0; i < H; i++)
+            if(e == _chosen[i])
+                return;
+
+        Base::remove(e);
+        Base::insert(e);
+    }
+
 private:
     using Base::remove;
     void chosen(Element * e) { _chosen[R::current_head()] = e; }
@@ -1340,6 +1966,10 @@ public:
         return _list[e->rank().queue()].choose(e);
     }
 
+    void update(Element * e) {
+        _list[e->rank().queue()].update(e);
+    }
+
 private:
     L _list[Q];
 };
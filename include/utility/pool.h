@@ -0,0 +1,113 @@
+// EPOS Object Pool Utility Declarations
+
+#ifndef __pool_h
+#define __pool_h
+
+#include <architecture.h>
+#include <utility/string.h>
+
+__BEGIN_UTIL
+
+// Object Pool
+// Each CPU keeps up to N free blocks of sizeof(T) bytes, given back by the objects deleted on it, and hands them out
+// again before going to the heap. Each CPU only touches its own blocks, which share no cache line with other CPUs', with
+// interrupts disabled, so getting and putting blocks takes no locks and never searches the heap; blocks that do not fit
+// go back to the heap (get() returning 0 and put() false tell the caller to use the heap instead). Only storage is
+// pooled: new and delete still run T's constructor and destructor. With Traits<Heaps>::debugged, pooled blocks are
+// filled with POISON, and blocks written to while in the pool (through dangling pointers) are reported by get().
+template<typename T, unsigned int N>
+class Pool
+{
+private:
+    static const unsigned int CPUS = Traits<Build>::CPUS;
+    static const bool debugged = Traits<Heaps>::debugged;
+    static const unsigned char POISON = 0xa5;
+
+    struct alignas(Traits<CPU>::CACHE_LINE_SIZE) Slot {
+        unsigned int count;
+        void * blocks[N ? N : 1];
+    };
+
+public:
+    Pool() {}
+
+    void * get() {
+        bool disabled = CPU::int_disabled();
+        CPU::int_disable();
+        Slot & s = _slot[CPU::id()];
+        void * b = s.count ? s.blocks[--s.count] : 0;
+        if(!disabled)
+            CPU::int_enable();
+
+        if(debugged && b)
+            check(b);
+
+        return b;
+    }
+
+    bool put(void * b) {
+        if(debugged && N)
+            memset(b, POISON, sizeof(T));
+
+        bool disabled = CPU::int_disabled();
+        CPU::int_disable();
+        Slot & s = _slot[CPU::id()];
+        bool kept = (s.count < N);
+        if(kept)
+            s.blocks[s.count++] = b;
+        if(!disabled)
+            CPU::int_enable();
+
+        return kept;
+    }
+
+private:
+    static void check(void * b) {
+        const unsigned char * p = reinterpret_cast<const unsigned char *>(b);
+        for(unsigned long i = 0; i < sizeof(T); i++)
+            if(p[i] != POISON) {
+                db<Heaps>(WRN) << "Pool::get: block " << b << " was written to at offset " << i << " after being freed!" << endl;
+                break;
+            }
+    }
+
+private:
+    Slot _slot[CPUS];
+};
+
+
+// Pooled Objects
+// Classes T that derive from Pooled<T, N> have their objects (but not those of derived classes, which are larger) come
+// from the current CPU's Pool<T, N> whenever it has any, and go back to it when deleted. Callers of new (SYSTEM) must
+// include system.h, as with any other class.
+template<typename T, unsigned int N = Traits<Heaps>::POOLED>
+class Pooled
+{
+public:
+    static void * operator new(size_t bytes) {
+        void * object = (bytes == sizeof(T)) ? _pool.get() : 0;
+        return object ? object : ::operator new(bytes);
+    }
+
+    static void * operator new(size_t bytes, const System_Allocator & allocator) {
+        void * object = (bytes == sizeof(T)) ? _pool.get() : 0;
+        return object ? object : ::operator new(bytes, allocator);
+    }
+
+    static void * operator new(size_t bytes, void * place) { return place; }
+
+    static void operator delete(void * object, size_t bytes) {
+        if((bytes != sizeof(T)) || !_pool.put(object))
+            ::operator delete(object);
+    }
+
+protected:
+    static Pool<T, N> _pool;
+};
+
+template<typename T, unsigned int N>
+Pool<T, N> Pooled<T, N>::_pool;
+
+__END_UTIL
+
+#endif
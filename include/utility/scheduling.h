@@ -30,7 +30,7 @@ private:
 public:
     typedef typename T::Criterion Criterion;
     typedef Scheduling_List<T, Criterion> Queue;
-    typedef typename Queue::Element Element;
+    typedef typename Base::Element Element;
 
 public:
     Scheduler() {}
@@ -49,6 +49,11 @@ public:
             return const_cast<T * volatile>(Base::chosen()->object());
     }
 
+    // Object chosen by a given head of a multihead list (heads that have not chosen anything yet yield 0)
+    T * volatile chosen(unsigned int head) {
+        return const_cast<T * volatile>((Base::chosen(head)) ? Base::chosen(head)->object() : 0);
+    }
+
     void insert(T * obj) {
         db<Scheduler>(TRC) << "Scheduler[chosen=" << chosen() << "]::insert(" << obj << ")" << endl;
 
@@ -83,6 +88,12 @@ public:
         return obj;
     }
 
+    void update(T * obj) {
+        db<Scheduler>(TRC) << "Scheduler[chosen=" << chosen() << "]::update(" << obj << ")" << endl;
+
+        Base::update(obj->link());
+    }
+
     T * choose_another() {
         db<Scheduler>(TRC) << "Scheduler[chosen=" << chosen() << "]::choose_another() => ";
 
@@ -0,0 +1,264 @@
+// EPOS Admission Control Implementation
+
+#include <real-time.h>
+
+__BEGIN_SYS
+
+// Utilizations and densities are kept in parts per billion, rounded up, so the tests never err on the optimistic side
+static const unsigned long long ONE = 1000000000ULL;
+
+// Busy periods that do not converge after this many iterations are taken as unschedulable
+static const unsigned int MAX_ITERATIONS = 1000;
+
+static inline unsigned long long ceil_div(unsigned long long a, unsigned long long b) { return (a + b - 1) / b; }
+
+// The priority a fixed-priority criterion would give a new periodic thread (only criteria that are both timed and static rank threads by their timing parameters)
+template<typename C, bool ranked = C::timed && !C::dynamic>
+struct Rank { static int of(Microsecond p, Microsecond d, Microsecond c) { return int(C(p, d, c)); } };
+
+template<typename C>
+struct Rank<C, false> { static int of(Microsecond p, Microsecond d, Microsecond c) { return 0; } };
+
+bool Admission_Control::admissible(unsigned int queue, const Task & task)
+{
+    db<Thread>(TRC) << "Admission_Control::admissible(q=" << queue << ",p=" << task.period << ",d=" << task.deadline << ",c=" << task.capacity << ")" << endl;
+
+    if((queue >= QUEUES) || !task.period)
+        return false;
+
+    Entry set[MAX_TASKS];
+    unsigned int n = admitted(queue, set);
+    if(n >= MAX_TASKS)
+        return false;
+
+    set[n++] = entry(task);
+
+    return schedulable(set, n);
+}
+
+unsigned int Admission_Control::place(const Task & task, Heuristic heuristic)
+{
+    db<Thread>(TRC) << "Admission_Control::place(p=" << task.period << ",d=" << task.deadline << ",c=" << task.capacity << ",h=" << heuristic << ")" << endl;
+
+    if(!task.period)
+        return NONE;
+
+    Entry set[QUEUES][MAX_TASKS];
+    unsigned int n[QUEUES];
+    for(unsigned int q = 0; q < QUEUES; q++)
+        n[q] = admitted(q, set[q]);
+
+    return fit(entry(task), set, n, heuristic);
+}
+
+bool Admission_Control::partition(Task * tasks, unsigned int count, Heuristic heuristic)
+{
+    db<Thread>(TRC) << "Admission_Control::partition(n=" << count << ",h=" << heuristic << ")" << endl;
+
+    Entry set[QUEUES][MAX_TASKS];
+    unsigned int n[QUEUES];
+    for(unsigned int q = 0; q < QUEUES; q++)
+        n[q] = admitted(q, set[q]);
+
+    // Tasks are placed by decreasing utilization (ties by index), on top of the threads already admitted to each queue
+    for(unsigned int i = 0; i < count; i++)
+        tasks[i].queue = NONE;
+
+    bool ok = true;
+    unsigned long long last_u = 0;
+    unsigned int last = NONE;
+    for(unsigned int k = 0; k < count; k++) {
+        unsigned int next = NONE;
+        unsigned long long next_u = 0;
+        for(unsigned int i = 0; i < count; i++) {
+            unsigned long long u = tasks[i].period ? ceil_div(tasks[i].capacity * ONE, tasks[i].period) : 0;
+            bool pending = (last == NONE) || (u < last_u) || ((u == last_u) && (i > last));
+            if(pending && ((next == NONE) || (u > next_u))) {
+                next = i;
+                next_u = u;
+            }
+        }
+        last = next;
+        last_u = next_u;
+
+        Task & task = tasks[next];
+        if(task.period)
+            task.queue = fit(entry(task), set, n, heuristic);
+        if(task.queue == NONE) {
+            db<Thread>(WRN) << "Admission_Control::partition: task " << next << " (p=" << task.period << ",d=" << task.deadline << ",c=" << task.capacity << ") does not fit!" << endl;
+            ok = false;
+        }
+    }
+
+    return ok;
+}
+
+Admission_Control::Entry Admission_Control::entry(const Task & task)
+{
+    Microsecond p = task.period;
+    Microsecond d = task.deadline ? task.deadline : task.period;
+    Microsecond c = task.capacity;
+
+    Entry e;
+    e.period = p;
+    e.deadline = d;
+    e.capacity = c;
+    e.rank = Rank<Criterion>::of(p, d, c);
+
+    return e;
+}
+
+unsigned int Admission_Control::admitted(unsigned int queue, Entry * set)
+{
+    unsigned int n = 0;
+
+    Thread::lock(queue);
+
+    for(unsigned int i = 0; (i < Thread::_load[queue].count) && (n < MAX_TASKS); i++) {
+        Thread * t = Thread::_load[queue].threads[i];
+        if(!t || !t->criterion().period()) // aperiodic threads get whatever is left
+            continue;
+
+        set[n].period = t->criterion().period();
+        set[n].deadline = t->criterion().deadline();
+        set[n].capacity = t->criterion().capacity();
+        set[n].rank = t->criterion();
+        n++;
+    }
+
+    Thread::unlock(queue);
+
+    return n;
+}
+
+unsigned long long Admission_Control::utilization(const Entry * set, unsigned int n)
+{
+    unsigned long long u = 0;
+    for(unsigned int i = 0; i < n; i++)
+        u += ceil_div(set[i].capacity * ONE, set[i].period);
+
+    return u;
+}
+
+unsigned int Admission_Control::fit(const Entry & task, Entry set[QUEUES][MAX_TASKS], unsigned int n[QUEUES], Heuristic heuristic)
+{
+    unsigned int chosen = NONE;
+    unsigned long long load = 0;
+
+    for(unsigned int q = 0; q < QUEUES; q++) {
+        if(n[q] >= MAX_TASKS)
+            continue;
+
+        set[q][n[q]] = task;
+        if(!schedulable(set[q], n[q] + 1))
+            continue;
+
+        unsigned long long u = utilization(set[q], n[q]);
+        if((chosen == NONE) || (u < load)) {
+            chosen = q;
+            load = u;
+        }
+
+        if(heuristic == FIRST_FIT)
+            break;
+    }
+
+    if(chosen != NONE)
+        set[chosen][n[chosen]++] = task;
+
+    return chosen;
+}
+
+bool Admission_Control::schedulable(const Entry * set, unsigned int n)
+{
+    if(HEADS > 1)
+        return density(set, n);
+    else if(Criterion::dynamic)
+        return processor_demand(set, n);
+    else
+        return response_time(set, n);
+}
+
+// Response-time analysis for fixed priorities: R = C_i + sum_{j in hp(i)} ceil(R / T_j) * C_j must converge before D_i.
+// Threads with the same priority are taken as interfering with each other.
+bool Admission_Control::response_time(const Entry * set, unsigned int n)
+{
+    for(unsigned int i = 0; i < n; i++) {
+        unsigned long long r = set[i].capacity;
+        for(unsigned long long next = 0; ; r = next) {
+            next = set[i].capacity;
+            for(unsigned int j = 0; j < n; j++)
+                if((j != i) && (set[j].rank <= set[i].rank))
+                    next += ceil_div(r, set[j].period) * set[j].capacity;
+
+            if(next > set[i].deadline)
+                return false;
+            if(next == r)
+                break;
+        }
+    }
+
+    return true;
+}
+
+// Processor demand criterion for EDF: U <= 1 suffices for implicit (or later) deadlines; otherwise the demand
+// h(t) = sum_{D_j <= t} (floor((t - D_j) / T_j) + 1) * C_j must not exceed t at any absolute deadline within the
+// synchronous busy period.
+bool Admission_Control::processor_demand(const Entry * set, unsigned int n)
+{
+    if(utilization(set, n) > ONE)
+        return false;
+
+    bool constrained = false;
+    unsigned long long busy = 0;
+    for(unsigned int i = 0; i < n; i++) {
+        constrained |= (set[i].deadline < set[i].period);
+        busy += set[i].capacity;
+    }
+    if(!constrained || !busy)
+        return true;
+
+    unsigned int iterations = 0;
+    for(unsigned long long next = 0; ; busy = next) {
+        next = 0;
+        for(unsigned int i = 0; i < n; i++)
+            next += ceil_div(busy, set[i].period) * set[i].capacity;
+        if(next == busy)
+            break;
+        if(++iterations >= MAX_ITERATIONS)
+            return false;
+    }
+
+    for(unsigned int i = 0; i < n; i++) {
+        for(unsigned long long t = set[i].deadline; t <= busy; t += set[i].period) {
+            unsigned long long demand = 0;
+            for(unsigned int j = 0; j < n; j++)
+                if(set[j].deadline <= t)
+                    demand += ((t - set[j].deadline) / set[j].period + 1) * set[j].capacity;
+            if(demand > t)
+                return false;
+        }
+    }
+
+    return true;
+}
+
+// GFB density bound for global EDF on m = HEADS processors: sum delta_i <= m - (m - 1) * delta_max, delta_i = C_i / min(D_i, T_i)
+bool Admission_Control::density(const Entry * set, unsigned int n)
+{
+    unsigned long long sum = 0;
+    unsigned long long max = 0;
+    for(unsigned int i = 0; i < n; i++) {
+        unsigned long long d = (set[i].deadline < set[i].period) ? set[i].deadline : set[i].period;
+        unsigned long long delta = ceil_div(set[i].capacity * ONE, d);
+        if(delta > ONE)
+            return false;
+        sum += delta;
+        if(delta > max)
+            max = delta;
+    }
+
+    return sum <= HEADS * ONE - (HEADS - 1) * max;
+}
+
+__END_SYS
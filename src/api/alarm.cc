@@ -9,22 +9,29 @@ __BEGIN_SYS
 
 Alarm_Timer * Alarm::_timer;
 volatile Alarm::Tick Alarm::_elapsed;
-Alarm::Queue Alarm::_request;
+Alarm::Queue Alarm::_request[QUEUES];
+Spin Alarm::_lock[QUEUES];
 
+// Alarms created by threads go to the queue of the CPU they run on (during boot there are no threads to ask)
 Alarm::Alarm(Microsecond time, Handler * handler, unsigned int times)
-: _time(time), _handler(handler), _times(times), _ticks(ticks(time)), _link(this, _ticks)
+: Alarm(time, handler, times, Thread::Criterion::current_queue()) {}
+
+Alarm::Alarm(Microsecond time, Handler * handler, unsigned int times, unsigned int queue)
+: _time(time), _handler(handler), _times(times), _ticks(ticks(time)), _queue(queue), _link(this, _ticks)
 {
-        lock();
+        lock(_queue);
 
-    db<Alarm>(TRC) << "Alarm(t=" << time << ",tk=" << _ticks << ",h=" << reinterpret_cast<void *>(handler) << ",x=" << times << ") => " << this << endl;
+    db<Alarm>(TRC) << "Alarm(t=" << time << ",tk=" << _ticks << ",h=" << reinterpret_cast<void *>(handler) << ",x=" << times << ",q=" << queue << ") => " << this << endl;
 
     if(_ticks) {
-        _request.insert(&_link);
-        unlock();
+        _link.rank(elapsed() + _ticks);
+        _request[_queue].insert(&_link);
+        program(_queue);
+        unlock(_queue);
     } else {
         db<Thread>(TRC) << "Thread( " << times << ")" << endl;
         assert(times == 1);
-        unlock();
+        unlock(_queue);
         (*handler)();
     }
     
@@ -32,46 +39,68 @@ Alarm::Alarm(Microsecond time, Handler * handler, unsigned int times)
 
 Alarm::~Alarm()
 {
-    lock();
+    unsigned int q = lock_queue();
 
     db<Alarm>(TRC) << "~Alarm(this=" << this << ")" << endl;
 
-    _request.remove(this);
+    _request[q].remove(&_link);
 
-    unlock();
+    unlock(q);
 }
 
 void Alarm::reset()
 {
-    bool locked = Thread::locked();
+    bool locked = Alarm::locked(_queue);
     if(!locked)
-        lock();
+        lock_queue();
 
     db<Alarm>(TRC) << "Alarm::reset(this=" << this << ")" << endl;
 
-    _request.remove(this);
-    _link.rank(_ticks);
-    _request.insert(&_link);
+    _request[_queue].remove(&_link);
+    _link.rank(elapsed() + _ticks);
+    _request[_queue].insert(&_link);
+    program(_queue);
 
     if(!locked)
-        unlock();
+        unlock(_queue);
 }
 
 void Alarm::period(Microsecond p)
 {
-    bool locked = Thread::locked();
+    bool locked = Alarm::locked(_queue);
     if(!locked)
-        lock();
+        lock_queue();
 
     db<Alarm>(TRC) << "Alarm::period(this=" << this << ",p=" << p << ")" << endl;
 
-    _request.remove(this);
+    // The alarm restarts with the new period, as reset() would
+    _request[_queue].remove(&_link);
     _time = p;
     _ticks = ticks(p);
-    _request.insert(&_link);
+    _link.rank(elapsed() + _ticks);
+    _request[_queue].insert(&_link);
+    program(_queue);
 
     if(!locked)
-        unlock();
+        unlock(_queue);
+}
+
+void Alarm::queue(unsigned int q)
+{
+    db<Alarm>(TRC) << "Alarm::queue(this=" << this << ",q=" << q << ")" << endl;
+
+    unsigned int old = _queue;
+    if(q == old)
+        return;
+
+    // The expiration is an absolute tick, so it holds in the other queue's wheel (or goes to its expired list if it is past)
+    bool pending = _request[old].remove(&_link);
+    _queue = q;
+    if(pending) {
+        _request[q].insert(&_link);
+        program(q);
+    }
+    program(old);
 }
 
 
@@ -86,13 +115,26 @@ void Alarm::delay(Microsecond time)
 }
 
 
-void Alarm::handler(IC::Interrupt_Id i)
+void Alarm::program(unsigned int q)
 {
-    lock();
+    if(!Alarm_Timer::tickless)
+        return;
+
+    Tick tick;
+    if(_request[q].expired())
+        _timer->expire(elapsed(), cpu(q)); // some are still to be handled, possibly by a nested handler
+    else if(_request[q].next(&tick))
+        _timer->expire(tick, cpu(q));
+    else
+        _timer->disarm(cpu(q));
+}
 
-    _elapsed++;
+void Alarm::handler(IC::Interrupt_Id i)
+{
+    if(!Alarm_Timer::tickless && (CPU::id() == CPU::BSP))
+        _elapsed++;
 
-    if(Traits<Alarm>::visible) {
+    if(Traits<Alarm>::visible && (CPU::id() == CPU::BSP)) {
         Display display;
         int lin, col;
         display.position(&lin, &col);
@@ -101,29 +143,43 @@ void Alarm::handler(IC::Interrupt_Id i)
         display.position(lin, col);
     }
 
-    Alarm * alarm = 0;
-
-    if(!_request.empty()) {
-        // Replacing the following "if" by a "while" loop is tempting, but recovering the lock and dispatching the handler is
-        // troublesome if the Alarm gets destroyed in between, like is the case for the idle thread returning to shutdown the machine
-        if(_request.head()->promote() <= 0) { // rank can be negative whenever multiple handlers get created for the same time tick
-            Queue::Element * e = _request.remove();
-            alarm = e->object();
-            if(alarm->_times != INFINITE)
-                alarm->_times--;
-            if(alarm->_times > 0) {
-                e->rank(alarm->_ticks);
-                _request.insert(e);
-            }
+    if(Alarm_Timer::alarms_per_cpu) {
+        if(!(CPU::id() % CPUS_PER_QUEUE))
+            handle(CPU::id() / CPUS_PER_QUEUE);
+    } else
+        for(unsigned int q = 0; q < QUEUES; q++)
+            handle(q);
+}
+
+void Alarm::handle(unsigned int q)
+{
+    lock(q);
+
+    _request[q].advance(elapsed());
+
+    // Every alarm that expired is handled, but one at a time and with the lock released, since handlers might dispatch
+    // other threads, which could in turn destroy (and thus remove from the expired list) alarms yet to be handled.
+    // Periodic alarms are reinserted relative to their last expiration, so a late handling does not make them drift.
+    for(Queue::Element * e; (e = _request[q].remove()); lock(q)) {
+        Alarm * alarm = e->object();
+        if(alarm->_times != INFINITE)
+            alarm->_times--;
+        if(alarm->_times > 0) {
+            e->rank(e->rank() + alarm->_ticks);
+            _request[q].insert(e);
         }
-    }
+        Handler * handler = alarm->_handler;
+        program(q);
 
-    unlock();
+        unlock(q);
 
-    if(alarm) {
-        db<Alarm>(TRC) << "Alarm::handler(this=" << alarm << ",e=" << _elapsed << ",h=" << reinterpret_cast<void*>(alarm->handler) << ")" << endl;
-        (*alarm->_handler)();
+        db<Alarm>(TRC) << "Alarm::handler(this=" << alarm << ",e=" << elapsed() << ",h=" << reinterpret_cast<void*>(handler) << ")" << endl;
+        (*handler)();
     }
+
+    program(q);
+
+    unlock(q);
 }
 
 __END_SYS
@@ -0,0 +1,232 @@
+// EPOS Coroutine Implementation
+
+#include <coroutine.h>
+#include <time.h>
+
+__BEGIN_SYS
+
+Coroutine::Loop Coroutine::_loop[CPUS];
+Coroutine::Joining Coroutine::_joining;
+
+bool Coroutine::start(unsigned int cpu)
+{
+    if(cpu == ANY)
+        cpu = CPU::id();
+
+    db<Coroutine>(TRC) << "Coroutine::start(this=" << this << ",cpu=" << cpu << ")" << endl;
+
+    if(cpu >= CPUS) {
+        db<Coroutine>(WRN) << "Coroutine::start: no such CPU (" << cpu << ")!" << endl;
+        return false;
+    }
+    if(_state != FINISHED) {
+        db<Coroutine>(WRN) << "Coroutine::start: coroutine already started!" << endl;
+        return false;
+    }
+
+    Loop & l = _loop[cpu];
+
+    // The loop's thread is kept on its CPU as far as the criterion allows, and does not keep EPOS running (see Thread::idle())
+    if(!CPU::tsl(l.spawned)) {
+        new (SYSTEM) Thread(Thread::Configuration(Thread::READY, Thread::Criterion(), Traits<Coroutine>::STACK_SIZE, 1UL << cpu), &loop, cpu);
+        CPU::fdec(Thread::_thread_count);
+    }
+
+    _line = 0;
+    _cpu = cpu;
+    _signaled = false;
+    _ended = false;
+
+    bool disabled = l.lock();
+    _wake = now();
+    l.count++;
+    _state = READY;
+    l.ready.insert(&_link);
+    bool wake = l.idle;
+    l.idle = false;
+    l.unlock(disabled);
+
+    if(wake)
+        l.wakeup.v();
+
+    return true;
+}
+
+void Coroutine::join()
+{
+    db<Coroutine>(TRC) << "Coroutine::join(this=" << this << ",state=" << _state << ")" << endl;
+
+    _joining.wait(this);
+}
+
+// Running coroutines are only marked, for their loop to requeue them when they return (see loop())
+void Coroutine::ready()
+{
+    Loop & l = _loop[_cpu];
+
+    bool disabled = l.lock();
+    bool wake = false;
+    if(l.running == this)
+        _state = READY;
+    else if(_state == WAITING) {
+        _state = READY;
+        l.ready.insert(&_link);
+        wake = l.idle;
+        l.idle = false;
+    }
+    l.unlock(disabled);
+
+    if(wake)
+        l.wakeup.v();
+}
+
+void Coroutine::delay(const Microsecond & time)
+{
+    _wake = now() + ticks(time);
+    _state = SLEEPING;
+}
+
+// Relative to the previous wake-up, so periods do not drift, and past ones are caught up on right away
+void Coroutine::wait_next(const Microsecond & period)
+{
+    _wake += ticks(period);
+    _state = SLEEPING;
+}
+
+int Coroutine::loop(unsigned int cpu)
+{
+    db<Coroutine>(TRC) << "Coroutine::loop(cpu=" << cpu << ")" << endl;
+
+    Loop & l = _loop[cpu];
+
+    for(;;) {
+        bool disabled = l.lock();
+
+        l.sleeping.advance(now());
+        for(Element * e = l.sleeping.remove(); e; e = l.sleeping.remove()) {
+            e->object()->_state = READY;
+            l.ready.insert(e);
+        }
+
+        if(!l.ready.empty()) {
+            Coroutine * c = l.ready.remove()->object();
+            c->_state = RUNNING;
+            l.running = c;
+            l.unlock(disabled);
+
+            c->run();
+
+            disabled = l.lock();
+            l.running = 0;
+            bool ended = c->_ended;
+            if(ended)
+                l.count--;
+            else if(c->_state == SLEEPING) {
+                c->_link.rank(c->_wake);
+                l.sleeping.insert(&c->_link);
+            } else if(c->_state != WAITING) // yielded or readied while running
+                l.ready.insert(&c->_link);
+            l.unlock(disabled);
+
+            if(ended)
+                _joining.signal(c); // the last time c is touched
+            continue;
+        }
+
+        // Nothing to run: block until a coroutine is readied or, if any sleeps, until the earliest might wake up
+        Tick next = 0;
+        bool timed = l.sleeping.next(&next);
+        l.idle = true;
+        l.unlock(disabled);
+
+        if(timed) {
+            Tick t = next - now();
+            Semaphore_Handler handler(&l.wakeup);
+            Alarm alarm((t > 0) ? Microsecond(t) * RESOLUTION : 0, &handler, 1);
+            l.wakeup.p();
+        } else
+            l.wakeup.p();
+
+        disabled = l.lock();
+        l.idle = false;
+        l.unlock(disabled);
+    }
+
+    return 0;
+}
+
+bool Coroutine::Semaphore::await(Coroutine * c)
+{
+    db<Coroutine>(TRC) << "Coroutine::Semaphore::await(this=" << this << ",c=" << c << ",value=" << _value << ")" << endl;
+
+    bool go;
+    bool disabled = lock();
+    if(!c->_signaled && (_value > 0)) {
+        _value--;
+        go = true;
+    } else
+        go = park(c);
+    unlock(disabled);
+
+    return go;
+}
+
+// Hands the unit straight to the first waiter, if any, so it cannot be taken by others before the waiter runs again
+void Coroutine::Semaphore::v()
+{
+    db<Coroutine>(TRC) << "Coroutine::Semaphore::v(this=" << this << ",value=" << _value << ")" << endl;
+
+    bool disabled = lock();
+    Coroutine * c = unpark();
+    if(!c)
+        _value++;
+    unlock(disabled);
+
+    if(c)
+        c->ready();
+}
+
+bool Coroutine::Condition::await(Coroutine * c)
+{
+    db<Coroutine>(TRC) << "Coroutine::Condition::await(this=" << this << ",c=" << c << ")" << endl;
+
+    bool disabled = lock();
+    bool go = park(c);
+    unlock(disabled);
+
+    return go;
+}
+
+void Coroutine::Condition::signal()
+{
+    db<Coroutine>(TRC) << "Coroutine::Condition::signal(this=" << this << ")" << endl;
+
+    bool disabled = lock();
+    Coroutine * c = unpark();
+    unlock(disabled);
+
+    if(c)
+        c->ready();
+}
+
+void Coroutine::Condition::broadcast()
+{
+    db<Coroutine>(TRC) << "Coroutine::Condition::broadcast(this=" << this << ")" << endl;
+
+    // Waiters are readied one at a time, so the lock is never held across a run loop's, and only those waiting already are
+    bool disabled = lock();
+    unsigned long n = _waiting.size();
+    unlock(disabled);
+
+    for(; n; n--) {
+        disabled = lock();
+        Coroutine * c = unpark();
+        unlock(disabled);
+
+        if(!c)
+            break;
+        c->ready();
+    }
+}
+
+__END_SYS
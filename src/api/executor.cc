@@ -0,0 +1,154 @@
+// EPOS Task Executor Implementation
+
+#include <executor.h>
+
+__BEGIN_SYS
+
+volatile bool Executor::_started;
+volatile bool Executor::_starting;
+Thread * Executor::_workers[WORKERS];
+Executor::Deque Executor::_deque[WORKERS];
+Executor::Deque Executor::_inbox[Traits<Machine>::CPUS];
+Simple_Spin Executor::_inbox_lock[Traits<Machine>::CPUS];
+Semaphore Executor::_pending(0);
+Executor::Completion Executor::_completion;
+volatile unsigned long Executor::_executed;
+volatile unsigned long Executor::_stolen;
+
+void Executor::submit(Future * future, Function * function, void * argument)
+{
+    db<Executor>(TRC) << "Executor::submit(f=" << future << ",e=" << reinterpret_cast<void *>(function) << ",a=" << argument << ")" << endl;
+
+    future->_function = function;
+    future->_argument = argument;
+    future->_result = 0;
+    future->_done = false;
+
+    if(!Traits<Executor>::enabled) {
+        db<Executor>(WRN) << "Executor::submit: the executor is disabled (see Traits<Executor>), running inline!" << endl;
+        run(future);
+        return;
+    }
+
+    if(!_started)
+        start();
+
+    bool queued;
+    int n = worker();
+    if(n >= 0)
+        queued = _deque[n].push(future);
+    else {
+        bool disabled = CPU::int_disabled();
+        CPU::int_disable();
+        unsigned int cpu = CPU::id();
+        _inbox_lock[cpu].acquire();
+        queued = _inbox[cpu].push(future);
+        _inbox_lock[cpu].release();
+        if(!disabled)
+            CPU::int_enable();
+    }
+
+    if(queued)
+        _pending.v();
+    else
+        run(future); // no room, so the submitter does it
+}
+
+int Executor::wait(Future * future)
+{
+    db<Executor>(TRC) << "Executor::wait(f=" << future << ")" << endl;
+
+    // Help while there is work around, be it the awaited one or not, and only then block
+    int n = worker();
+    while(!future->_done) {
+        Future * f = find(n);
+        if(f)
+            run(f);
+        else
+            _completion.wait(future);
+    }
+
+    return future->_result;
+}
+
+void Executor::start()
+{
+    if(CPU::tsl(_starting)) {
+        while(!_started)
+            Thread::yield();
+        return;
+    }
+
+    db<Executor>(TRC) << "Executor::start(workers=" << WORKERS << ")" << endl;
+
+    for(unsigned int i = 0; i < WORKERS; i++) {
+        _workers[i] = new (SYSTEM) Thread(Thread::Configuration(Thread::READY, Thread::Criterion(), Traits<Executor>::STACK_SIZE), &work, i);
+        CPU::fdec(Thread::_thread_count); // workers do not keep EPOS running (see Thread::idle())
+    }
+
+    _started = true;
+}
+
+int Executor::work(unsigned int n)
+{
+    // Each token in _pending stands for a submission, which helpers might have run already
+    for(;;) {
+        _pending.p();
+        for(Future * f = find(n); f; f = find(n))
+            run(f);
+    }
+
+    return 0;
+}
+
+int Executor::worker()
+{
+    Thread * self = Thread::self();
+    for(unsigned int i = 0; i < WORKERS; i++)
+        if(_workers[i] == self)
+            return i;
+
+    return -1;
+}
+
+// Own work first, newest first, then the inbox of the current CPU and, only then, the oldest work of others
+Executor::Future * Executor::find(int n)
+{
+    Future * f = (n >= 0) ? _deque[n].pop() : 0;
+    if(f)
+        return f;
+
+    unsigned int cpu = CPU::id();
+    f = _inbox[cpu].steal();
+    if(f)
+        return f;
+
+    unsigned int first = (n >= 0) ? n + 1 : 0;
+    for(unsigned int i = 0; i < WORKERS; i++) {
+        unsigned int victim = (first + i) % WORKERS;
+        if(int(victim) == n)
+            continue;
+        f = _deque[victim].steal();
+        if(f) {
+            CPU::finc(_stolen);
+            return f;
+        }
+    }
+
+    for(unsigned int i = 1; i < Traits<Machine>::CPUS; i++) {
+        f = _inbox[(cpu + i) % Traits<Machine>::CPUS].steal();
+        if(f)
+            return f;
+    }
+
+    return 0;
+}
+
+void Executor::run(Future * f)
+{
+    f->_result = f->_function(f->_argument);
+    CPU::finc(_executed);
+    _completion.signal(f);
+}
+
+__END_SYS
@@ -0,0 +1,164 @@
+// EPOS DVFS Governor Implementation
+
+#include <governor.h>
+
+__BEGIN_SYS
+
+extern OStream kout;
+
+// Densities are kept in parts per million, rounded up, so the DEADLINE policy never errs on the optimistic side
+static const unsigned long long ONE = 1000000ULL;
+
+static inline unsigned long long ceil_div(unsigned long long a, unsigned long long b) { return (a + b - 1) / b; }
+
+volatile Governor::Policy Governor::_policy;
+Governor::Time_Stamp Governor::_period;
+volatile bool Governor::_dumping;
+Governor::Time_Stamp Governor::_last[CPUS];
+Governor::Time_Stamp Governor::_idle[CPUS];
+Governor::Time_Stamp Governor::_idle_since[CPUS];
+bool Governor::_idling[CPUS];
+Percent Governor::_load[CPUS];
+Governor::Decision Governor::_trace[CPUS][TRACE];
+volatile unsigned long Governor::_decided[CPUS];
+
+void Governor::policy(Policy p)
+{
+    db<Governor>(TRC) << "Governor::policy(p=" << p << ")" << endl;
+
+    _policy = p; // each CPU applies it at its next decision
+}
+
+// Runs on the CPU it decides for, with the CPU's scheduling queue locked (see Thread::time_slicer() and Thread::dispatch())
+void Governor::decide(unsigned int cpu)
+{
+    Time_Stamp now = TSC::time_stamp();
+    Time_Stamp window = now - _last[cpu];
+
+    if(_idling[cpu]) {
+        _idle[cpu] += now - _idle_since[cpu];
+        _idle_since[cpu] = now;
+    }
+    Time_Stamp idle = (_idle[cpu] < window) ? _idle[cpu] : window;
+    unsigned int sample = 100 - idle * 100 / window;
+    _load[cpu] = ((_load[cpu] << SMOOTHING) - _load[cpu] + sample) >> SMOOTHING;
+    _idle[cpu] = 0;
+    _last[cpu] = now;
+
+    Policy policy = _policy;
+    Hertz target;
+    switch(policy) {
+    case PERFORMANCE: target = CPU::max_clock(); break;
+    case POWERSAVE: target = CPU::min_clock(); break;
+    case ONDEMAND: target = ondemand(cpu); break;
+    case DEADLINE: target = deadline(cpu); break;
+    default: target = CPU::max_clock();
+    }
+    if(target > CPU::max_clock())
+        target = CPU::max_clock();
+    if(target < CPU::min_clock())
+        target = CPU::min_clock();
+
+    // Raising the clock is never delayed, while lowering it must be worth more than HYSTERESIS
+    Hertz from = CPU::clock();
+    if((target > from) || ((from - target) * 100 > CPU::max_clock() * Traits<Governor>::HYSTERESIS))
+        CPU::clock(target);
+    Hertz to = CPU::clock();
+
+    if((to != from) && !_dumping) {
+        db<Governor>(INF) << "Governor::decide(cpu=" << cpu << ",p=" << policy << ",l=" << _load[cpu] << "%,f=" << from << "=>" << to << ")" << endl;
+
+        Decision & d = _trace[cpu][_decided[cpu] % TRACE];
+        d.time = now / (TSC::frequency() / 1000000);
+        d.policy = policy;
+        d.load = _load[cpu];
+        d.from = from;
+        d.to = to;
+        _decided[cpu]++;
+    }
+}
+
+// The clock at which the smoothed load would sit at UP_THRESHOLD, or the maximum if it is already above it
+Hertz Governor::ondemand(unsigned int cpu)
+{
+    if(_load[cpu] >= UP_THRESHOLD)
+        return CPU::max_clock();
+
+    return CPU::clock() * _load[cpu] / UP_THRESHOLD;
+}
+
+// Capacities are taken as execution times at max_clock(), so EDF still meets every deadline at the fraction of it given
+// by the total density of the periodic threads on the queue (GFB-style for queues shared by several CPUs, in which no
+// thread can run faster than a single CPU). Periodic threads that do not declare capacities need max_clock() and, with
+// no periodic threads at all, the CPU is governed on demand.
+Hertz Governor::deadline(unsigned int cpu)
+{
+    static const unsigned int CPUS_PER_QUEUE = CPUS / Thread::Criterion::QUEUES;
+
+    unsigned int queue = Thread::Criterion::current_queue();
+    unsigned long long sum = 0;
+    unsigned long long max = 0;
+    bool periodic = false;
+
+    for(unsigned int i = 0; i < Thread::_load[queue].count; i++) {
+        Thread * t = Thread::_load[queue].threads[i];
+        if(!t || !t->criterion().period())
+            continue;
+
+        Microsecond c = t->criterion().capacity();
+        if(!c)
+            return CPU::max_clock();
+
+        Microsecond p = t->criterion().period();
+        Microsecond d = t->criterion().deadline();
+        unsigned long long delta = ceil_div(c * ONE, (d && (d < p)) ? d : p);
+        sum += delta;
+        if(delta > max)
+            max = delta;
+        periodic = true;
+    }
+
+    if(!periodic)
+        return ondemand(cpu);
+
+    unsigned long long u = ceil_div(sum, CPUS_PER_QUEUE);
+    if(u < max)
+        u = max;
+
+    return ceil_div(CPU::max_clock() * u, ONE);
+}
+
+void Governor::dump()
+{
+    if(!Traits<Governor>::enabled)
+        return;
+
+    db<Governor>(TRC) << "Governor::dump()" << endl;
+
+    bool disabled = CPU::int_disabled();
+    CPU::int_disable();
+
+    _dumping = true;
+
+    // One line per clock change, "gov <cpu> <time (us)> <policy> <load (%)> <from (Hz)> <to (Hz)>", oldest first on each
+    // CPU, and the number of changes that did not fit in each trace as "gov-lost <cpu> <count>"
+    kout << "\n*** EPOS governor trace begins" << endl;
+    for(unsigned int cpu = 0; cpu < CPUS; cpu++) {
+        unsigned long decided = _decided[cpu];
+        unsigned long first = (decided > TRACE) ? decided - TRACE : 0;
+        for(unsigned long i = first; i < decided; i++) {
+            const Decision & d = _trace[cpu][i % TRACE];
+            kout << "gov " << cpu << " " << d.time << " " << d.policy << " " << d.load << " " << d.from << " " << d.to << "\n";
+        }
+        if(first)
+            kout << "gov-lost " << cpu << " " << first << "\n";
+    }
+    kout << "*** EPOS governor trace ends" << endl;
+
+    _dumping = false;
+
+    if(!disabled)
+        CPU::int_enable();
+}
+
+__END_SYS
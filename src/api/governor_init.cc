@@ -0,0 +1,20 @@
+// EPOS DVFS Governor Initialization
+
+#include <governor.h>
+#include <system.h>
+
+__BEGIN_SYS
+
+void Governor::init()
+{
+    db<Init, Governor>(TRC) << "Governor::init()" << endl;
+
+    if(CPU::id() == CPU::BSP) {
+        _policy = Policy(Traits<Governor>::POLICY);
+        _period = Time_Stamp(Traits<Governor>::PERIOD) * (TSC::frequency() / 1000000);
+    }
+
+    _last[CPU::id()] = TSC::time_stamp();
+}
+
+__END_SYS
@@ -0,0 +1,89 @@
+// EPOS Sampling Profiler Implementation
+
+#include <profiler.h>
+
+__BEGIN_SYS
+
+extern OStream kout;
+
+Profiler::Event Profiler::_event[PMU::CHANNELS];
+volatile bool Profiler::_dumping;
+Profiler::Sample Profiler::_samples[Traits<Machine>::CPUS][SAMPLES];
+volatile unsigned long Profiler::_taken[Traits<Machine>::CPUS];
+
+bool Profiler::start(Event event, Count period, Channel channel)
+{
+    db<Profiler>(TRC) << "Profiler::start(e=" << event << ",p=" << period << ",c=" << channel << ")" << endl;
+
+    if(!Traits<Profiler>::enabled) {
+        db<Profiler>(WRN) << "Profiler::start: the profiler is disabled (see Traits<Profiler>)!" << endl;
+        return false;
+    }
+
+    if(channel >= PMU::CHANNELS)
+        return false;
+
+    _event[channel] = event;
+
+    return PMU::arm(channel, event, period, &sample);
+}
+
+void Profiler::stop(Channel channel)
+{
+    db<Profiler>(TRC) << "Profiler::stop(c=" << channel << ")" << endl;
+
+    PMU::disarm(channel);
+}
+
+void Profiler::sample(Channel channel, void * ip)
+{
+    unsigned int cpu = CPU::id();
+
+    if(_dumping)
+        return;
+
+    // Each CPU only touches its own ring, always with interrupts disabled
+    Sample & s = _samples[cpu][_taken[cpu] % SAMPLES];
+    s.cpu = cpu;
+    s.thread = Thread::self();
+    s.ip = ip;
+    s.event = _event[channel];
+    _taken[cpu]++;
+}
+
+void Profiler::dump()
+{
+    if(!Traits<Profiler>::enabled)
+        return;
+
+    db<Profiler>(TRC) << "Profiler::dump()" << endl;
+
+    bool disabled = CPU::int_disabled();
+    CPU::int_disable();
+
+    _dumping = true;
+    for(Channel c = 0; c < PMU::CHANNELS; c++)
+        PMU::disarm(c);
+
+    // One line per sample, "prof <cpu> <thread> <event> <ip>", oldest first on each CPU, and the number of samples
+    // that did not fit in each ring as "prof-lost <cpu> <count>"
+    kout << "\n*** EPOS profile begins" << endl;
+    for(unsigned int cpu = 0; cpu < Traits<Machine>::CPUS; cpu++) {
+        unsigned long taken = _taken[cpu];
+        unsigned long first = (taken > SAMPLES) ? taken - SAMPLES : 0;
+        for(unsigned long i = first; i < taken; i++) {
+            const Sample & s = _samples[cpu][i % SAMPLES];
+            kout << "prof " << s.cpu << " " << reinterpret_cast<void *>(s.thread) << " " << s.event << " " << s.ip << "\n";
+        }
+        if(first)
+            kout << "prof-lost " << cpu << " " << first << "\n";
+    }
+    kout << "*** EPOS profile ends" << endl;
+
+    _dumping = false;
+
+    if(!disabled)
+        CPU::int_enable();
+}
+
+__END_SYS
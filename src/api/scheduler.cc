@@ -20,8 +20,48 @@ Microsecond RT_Common::time(Tick ticks)
     return Timer_Common::time(ticks, Alarm::timer()->frequency());
 }
 
+bool RT_Common::exhausted()
+{
+    return (_overrun != IGNORE) && _capacity && _released && !_overran && (_usage + elapsed() - _dispatch >= _capacity);
+}
+
+Microsecond RT_Common::job_budget()
+{
+    if((_overrun == IGNORE) || !_capacity || !_released || _overran)
+        return 0;
+
+    return (_usage < _capacity) ? time(_capacity - _usage) : Microsecond(1); // an exhausted budget must still expire (as soon as possible)
+}
+
 void RT_Common::handle(Event event)
 {
+    Tick now = elapsed();
+
+    // Per-job execution time accounting for budget enforcement
+    if(event & ENTER)
+        _dispatch = now;
+    if(event & (LEAVE | JOB_FINISH)) {
+        _usage += now - _dispatch;
+        _dispatch = now;
+    }
+    if(event & JOB_RELEASE) {
+        if(demoted())
+            _priority = _demoted;
+        _overran = false;
+        _released = true;
+        _usage = 0;
+        _dispatch = now;
+    }
+    if(event & JOB_FINISH)
+        _released = false;
+    if(event & OVERRUN) {
+        _overran = true;
+        if(_overrun == DEMOTE) {
+            _demoted = _priority;
+            _priority = APERIODIC;
+        }
+    }
+
     db<Thread>(TRC) << "RT::handle(this=" << this << ",e=";
     if (event & CREATE)
     {
@@ -50,6 +90,8 @@ void RT_Common::handle(Event event)
 
         _statistics.thread_last_preemption = elapsed();
         _statistics.thread_execution_time += cpu_time;
+        if(_statistics.job_released)
+            _statistics.job_utilization += cpu_time;
 
         _statistics.current_instructions_retired += PMU::read(2);
         _statistics.current_branch_misprediction += PMU::read(3);
@@ -68,16 +110,14 @@ void RT_Common::handle(Event event)
     if (periodic() && (event & JOB_FINISH))
     {
         db<Thread>(TRC) << "WAIT";
-        _statistics.current_instructions_retired += PMU::read(2);
-        _statistics.current_branch_misprediction += PMU::read(3);
-        _statistics.current_cache_miss += PMU::read(4);
-        _statistics.instructions_retired = _statistics.current_instructions_retired;
-        _statistics.branch_misprediction = _statistics.current_branch_misprediction;
-        _statistics.cache_miss = _statistics.current_cache_miss;
+        // The counts since the last dispatch are still in the PMU and will be accumulated at LEAVE, so they are not added to current_* here
+        _statistics.instructions_retired = _statistics.current_instructions_retired + PMU::read(2);
+        _statistics.branch_misprediction = _statistics.current_branch_misprediction + PMU::read(3);
+        _statistics.cache_miss = _statistics.current_cache_miss + PMU::read(4);
         _statistics.job_released = false;
         _statistics.job_finish = elapsed();
         _statistics.jobs_finished++;
-        //        _statistics.job_utilization += elapsed() - _statistics.thread_last_dispatch;
+        _statistics.job_utilization = _usage; // including the time since the last dispatch, which LEAVE would no longer charge to this job
     }
     if (periodic() && (event & JOB_RESTART))
     {
@@ -86,6 +126,10 @@ void RT_Common::handle(Event event)
         _statistics.current_branch_misprediction = 0;
         _statistics.current_cache_miss = 0;
     }
+    if (event & OVERRUN)
+    {
+        db<Thread>(TRC) << "|OVERRUN";
+    }
     if (event & COLLECT)
     {
         db<Thread>(TRC) << "|COLLECT";
@@ -106,10 +150,10 @@ void RT_Common::handle(Event event)
 }
 
 template <typename... Tn>
-FCFS::FCFS(int p, Tn &...an) : Priority((p == IDLE) ? IDLE : RT_Common::elapsed()) {}
+FCFS::FCFS(int p, const Tn &... an) : Priority((p == IDLE) ? IDLE : RT_Common::elapsed()) {}
 
 
-EDF::EDF(Microsecond p, Microsecond d, Microsecond c) : RT_Common(int(elapsed() + ticks(d)), p, d, c) {}
+EDF::EDF(Microsecond p, Microsecond d, Microsecond c, unsigned int cpu) : RT_Common(int(elapsed() + ticks(d)), p, d, c) {}
 
 void EDF::handle(Event event)
 {
@@ -121,16 +165,64 @@ void EDF::handle(Event event)
 }
 
 
-void LLF::handle(Event event)
+CBS::CBS(const Server & s) : EDF(APERIODIC), _server(s.budget && s.period), _budget(ticks(s.budget)), _last_charge(0)
 {
-    if (periodic() && ((event & UPDATE) | (event & JOB_RELEASE) | (event & JOB_FINISH)))
-    {
-        _priority = elapsed() + _deadline - _capacity + _statistics.job_utilization;
+    if(_server) {
+        // Budgets and periods shorter than half a tick would round down to 0 ticks, and charge() would never get past an empty budget
+        _period = _deadline = Math::max(ticks(s.period), Tick(1));
+        _capacity = _budget = Math::min(Math::max(_budget, Tick(1)), _period);
+        _priority = elapsed() + _deadline;
     }
+}
+
+void CBS::handle(Event event)
+{
+    EDF::handle(event);
+
+    if(!_server)
+        return;
+
+    Tick now = elapsed();
+
+    if(event & ENTER) {
+        Tick deadline = Tick(_priority);
+        if((deadline <= now) || (_budget * _period >= (deadline - now) * _capacity)) {
+            _priority = now + _deadline;
+            _budget = _capacity;
+        }
+        _last_charge = now;
+    }
+
+    if(event & (CHARGE | LEAVE)) {
+        charge(now - _last_charge);
+        _last_charge = now;
+    }
+}
+
+void CBS::charge(Tick used)
+{
+    // Each exhaustion postpones the deadline by one period and refills the budget
+    while(used >= _budget) {
+        used -= _budget;
+        _budget = _capacity;
+        _priority += _period;
+    }
+    _budget -= used;
+}
+
+
+LLF::LLF(Microsecond p, Microsecond d, Microsecond c, unsigned int cpu) : RT_Common(int(elapsed() + ticks((d ? d : p) - c)), p, d, c) {}
+
+void LLF::handle(Event event)
+{
     RT_Common::handle(event);
 
-    // Update the priority of the thread at job releases, before _alarm->v(), so it enters the queue in the right order (called from Periodic_Thread::Xxx_Handler)
-    //    if((_priority >= PERIODIC) && (_priority < APERIODIC) && ((event & JOB_FINISH) || (event & UPDATE_ALL)))
+    // The laxity of every ready thread shrinks at the same pace as time goes by, so only the running thread can change
+    // its relative order, by consuming part of its capacity. Hence the rank is the job's laxity at release plus the
+    // utilization so far, which only has to be updated at job releases and when the thread leaves the CPU (in
+    // Thread::dispatch()), instead of recomputing the laxity of every thread at each dispatch.
+    if (periodic() && (event & (JOB_RELEASE | LEAVE)) && !demoted())
+        _priority = _statistics.job_release + _deadline - _capacity + _statistics.job_utilization;
 }
 
 // Since the definition above is only known to this unit, forcing its instantiation here so it gets emitted in scheduler.o for subsequent linking with other units is necessary.
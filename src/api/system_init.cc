@@ -3,6 +3,7 @@
 #include <system.h>
 #include <time.h>
 #include <process.h>
+#include <governor.h>
 
 __BEGIN_SYS
 
@@ -15,6 +16,9 @@ void System::init()
     }
 
     // These abstractions are initialized by all CPUs
+    if(Traits<Governor>::enabled)
+        Governor::init();
+
     if(Traits<Thread>::enabled)
         Thread::init();
 }
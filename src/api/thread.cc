@@ -4,6 +4,8 @@
 #include <time.h>
 #include <process.h>
 #include <synchronizer.h>
+#include <profiler.h>
+#include <governor.h>
 
 __BEGIN_SYS
 
@@ -12,46 +14,140 @@ extern OStream kout;
 bool Thread::_not_booting;
 volatile unsigned int Thread::_thread_count;
 volatile unsigned int Thread::_changes_count;
-volatile unsigned int Thread::_cpu_thread_count[Traits<Machine>::CPUS];
-volatile Thread* Thread::_cpu_threads[Traits<Machine>::CPUS][Traits<Machine>::MAX_THREADS];
-volatile unsigned long long Thread::_cpu_last_dispatch[Traits<Machine>::CPUS];
-volatile unsigned long long  Thread::_cpu_instructions_per_second[Traits<Machine>::CPUS];
-
-volatile unsigned long long  Thread::_cpu_instructions_per_second_required[Traits<Machine>::CPUS];
-volatile unsigned long long  Thread::_cpu_branch_missprediction_per_second[Traits<Machine>::CPUS];
+Thread::Load Thread::_load[Traits<Machine>::CPUS];
 
 Scheduler_Timer *Thread::_timer;
 Scheduler<Thread> Thread::_scheduler;
-Spin Thread::_lock;
+Thread::Queue_Lock Thread::_lock[Thread::Criterion::QUEUES];
+Pool<char[Thread::STACK_SIZE], Traits<Thread>::CACHED> Thread::_stacks;
 
 
 void Thread::change_thread_queue_if_necessary() {
     db<Thread>(TRC) << "Thread::change_thread_queue_if_necessary(cpu=" << CPU::id() << ",this=" << running() << ")" << endl;
+
+    // Only partitioned criteria (one queue per CPU) can move threads around
+    if(Criterion::QUEUES != Traits<Machine>::CPUS)
+        return;
+
     unsigned int cpu_selected = select_cpu_by_use_rate();
-    unsigned long long cpu_selected_use = _cpu_branch_missprediction_per_second[cpu_selected]*15 + _cpu_instructions_per_second_required[cpu_selected];
     unsigned int current_cpu = CPU::id();
 
     if(cpu_selected == current_cpu) return;
 
-    for(unsigned int i = 0; i < _cpu_thread_count[current_cpu]; i++) {
-        Thread* t = const_cast<Thread* volatile>(_cpu_threads[current_cpu][i]);
-        unsigned long long cpu_selected_use_predict = cpu_selected_use + t->branch_misprediction_per_second*15 + t->instructions_per_second;
-        if(cpu_selected_use_predict < _cpu_branch_missprediction_per_second[current_cpu]*15 + _cpu_instructions_per_second_required[current_cpu]){
-            t->decrease_cost();
-            t->criterion().queue(cpu_selected);
-            t->increase_cost();
-            _changes_count++;
-            return;
+    Alarm::lock(current_cpu, cpu_selected);
+    lock(current_cpu, cpu_selected);
+
+    unsigned long long here = _load[current_cpu].misses*15 + _load[current_cpu].required;
+    unsigned long long there = _load[cpu_selected].misses*15 + _load[cpu_selected].required;
+    TSC::Time_Stamp now = TSC::time_stamp();
+
+    // The thread to move is the one whose move most reduces the larger of the two loads, net of the cache it would leave
+    // behind, so cache-heavy threads stay where their lines are unless the imbalance is worth refilling them
+    Thread * chosen = 0;
+    unsigned long long best = 0;
+    for(unsigned int i = 0; i < _load[current_cpu].count; i++) {
+        Thread* t = _load[current_cpu].threads[i];
+        if(!(t->_affinity & (1UL << cpu_selected)) || t->settling(now))
+            continue;
+        unsigned long long use = t->branch_misprediction_per_second*15 + t->instructions_per_second;
+        if(there + use >= here)
+            continue;
+        unsigned long long gain = (use < here - there - use) ? use : here - there - use;
+        unsigned long long cost = t->migration_cost() + here * MIGRATION_HYSTERESIS / 100;
+        if((gain > cost) && (gain - cost > best)) {
+            chosen = t;
+            best = gain - cost;
         }
     }
+
+    if(chosen) {
+        db<Thread>(TRC) << "Thread::change_thread_queue_if_necessary: " << chosen << " => " << cpu_selected << " (gain=" << best << ",footprint=" << chosen->footprint << ")" << endl;
+
+        chosen->decrease_cost();
+        migrate(chosen, cpu_selected);
+        if(preemptive && (chosen->_state == READY))
+            reschedule(cpu_selected);
+        chosen->increase_cost();
+        chosen->_migrated = now;
+        CPU::finc(_changes_count);
+    }
+
+    unlock_queue(cpu_selected);
+    unlock_queue(current_cpu);
+    Alarm::unlock(current_cpu, cpu_selected);
 }
 
-Hertz Thread::calculate_frequency(){
-    Hertz current_frequency = CPU::clock();
-    unsigned long long instructions_per_second = _cpu_instructions_per_second[CPU::id()];
-    unsigned long long instructions_per_second_required = _cpu_instructions_per_second_required[CPU::id()];
+bool Thread::steal()
+{
+    unsigned int thief = Criterion::current_queue();
+
+    // The victim is the most loaded queue (by required instructions per second) that has someone waiting
+    unsigned int victim = thief;
+    unsigned long long load = 0;
+    for(unsigned int q = 0; q < Criterion::QUEUES; q++)
+        if((q != thief) && (_load[q].count > 1) && ((victim == thief) || (_load[q].required > load))) {
+            victim = q;
+            load = _load[q].required;
+        }
+
+    if(victim == thief)
+        return false;
+
+    Alarm::lock(thief, victim);
+    lock(thief, victim);
+
+    // Prefer aperiodic threads, which carry no load accounting, over periodic ones allowed to run here, and among these the
+    // one that leaves the least cache behind, as long as it has not just been moved
+    Thread * stolen = 0;
+    unsigned long long cost = 0;
+    TSC::Time_Stamp now = TSC::time_stamp();
+    for(unsigned int i = 0; i < _load[victim].count; i++) {
+        Thread * t = _load[victim].threads[i];
+        if((t->_state == READY) && (t->_affinity & (1UL << thief)) && (t->_link.rank().queue() == victim)) {
+            if(!t->criterion().periodic()) {
+                stolen = t;
+                break;
+            }
+            if(t->settling(now))
+                continue;
+            unsigned long long c = t->migration_cost();
+            if(!stolen || (c < cost)) {
+                stolen = t;
+                cost = c;
+            }
+        }
+    }
+
+    if(stolen) {
+        db<Thread>(TRC) << "Thread::steal(cpu=" << thief << ",victim=" << victim << ") => " << stolen << endl;
+
+        stolen->decrease_cost();
+        migrate(stolen, thief);
+        stolen->increase_cost();
+        stolen->_migrated = now;
+    }
 
-    return (instructions_per_second ==  0 ? current_frequency : current_frequency * instructions_per_second_required / instructions_per_second);
+    unlock_queue(victim);
+    unlock_queue(thief);
+    Alarm::unlock(thief, victim);
+
+    return stolen;
+}
+
+void Thread::migrate(Thread * t, unsigned int q)
+{
+    db<Thread>(TRC) << "Thread::migrate(t=" << t << ",q=" << q << ")" << endl;
+
+    bool ready = (t->_state == READY);
+    if(ready) // move it to the other queue's list
+        _scheduler.suspend(t);
+    t->criterion().queue(q);
+    if(ready)
+        _scheduler.resume(t);
+
+    // Otherwise, its releases would still expire on the old queue's CPU, which would have to interrupt the new one
+    if(t->_job_alarm)
+        t->_job_alarm->queue(q);
 }
 
 unsigned int Thread::get_changes_count(){
@@ -59,27 +155,31 @@ unsigned int Thread::get_changes_count(){
 }
 
 unsigned long long Thread::get_instructions_per_second(unsigned int cpu){
-    return _cpu_instructions_per_second[cpu];
+    return _load[cpu].retired;
 }
 
 unsigned long long Thread::get_instructions_per_second_required(unsigned int cpu){
-    return _cpu_instructions_per_second_required[cpu];
+    return _load[cpu].required;
 }
 
 unsigned long long Thread::get_branch_misprediction_per_second(unsigned int cpu){
-    return _cpu_branch_missprediction_per_second[cpu];
+    return _load[cpu].misses;
 }
 
 unsigned int Thread::get_thread_count(unsigned int cpu){
-    return _cpu_thread_count[cpu];
+    return _load[cpu].count;
+}
+
+unsigned int Thread::get_utilization(unsigned int cpu){
+    return _load[cpu].utilization;
 }
 
 unsigned int Thread::select_cpu_by_use_rate() {
     unsigned int cpu_selected = 0;
-    unsigned long long current_is = _cpu_branch_missprediction_per_second[cpu_selected]*15 + _cpu_instructions_per_second_required[cpu_selected];
+    unsigned long long current_is = _load[cpu_selected].misses*15 + _load[cpu_selected].required;
 
     for(unsigned int cpu = 1; cpu < Traits<Machine>::CPUS; cpu++){
-        unsigned long long is = _cpu_branch_missprediction_per_second[cpu]*15 + _cpu_instructions_per_second_required[cpu];
+        unsigned long long is = _load[cpu].misses*15 + _load[cpu].required;
         if(is < current_is){
             cpu_selected = cpu;
             current_is = is;
@@ -90,51 +190,204 @@ unsigned int Thread::select_cpu_by_use_rate() {
 }
 
 void Thread::increase_cost(){
-    instructions_per_second = statistics().instructions_retired * 1000000ULL / criterion().period();
-    branch_misprediction_per_second = statistics().branch_misprediction * 1000000ULL / criterion().period();
-
-    _cpu_instructions_per_second_required[criterion().queue()] += instructions_per_second;
-    _cpu_branch_missprediction_per_second[criterion().queue()] += branch_misprediction_per_second;
+    // Threads keep their averages across queues; only periodic threads that have none yet are seeded with their statistics
+    if(!instructions_per_second && criterion().period()) {
+        instructions_per_second = statistics().instructions_retired * 1000000ULL / criterion().period();
+        branch_misprediction_per_second = statistics().branch_misprediction * 1000000ULL / criterion().period();
+    }
 
-    _cpu_threads[this->criterion().queue()][_cpu_thread_count[this->criterion().queue()]] = this;
-    _cpu_thread_count[this->criterion().queue()] += 1;
+    Load & load = _load[criterion().queue()];
+    load.required += instructions_per_second;
+    load.misses += branch_misprediction_per_second;
+    load.insert(this);
 
+    _cold = true; // whether just created or moved
 }
 
 void Thread::decrease_cost(){
-    _cpu_instructions_per_second_required[criterion().queue()] -= instructions_per_second;
-    _cpu_branch_missprediction_per_second[criterion().queue()] -= branch_misprediction_per_second;
-
-    for(unsigned int i = 0; i < _cpu_thread_count[criterion().queue()]; i++){
-        if(_cpu_threads[criterion().queue()][i] == this){
-            _cpu_threads[criterion().queue()][i] = nullptr;
-            for(unsigned int j = i + 1; j < _cpu_thread_count[criterion().queue()]; j++){
-                _cpu_threads[criterion().queue()][j-1] = _cpu_threads[criterion().queue()][j];
-                _cpu_threads[criterion().queue()][j] = nullptr;
-            }
-            _cpu_thread_count[criterion().queue()] -= 1;
-            break;
+    if(_slot == NO_SLOT) // never accounted for (e.g. MAIN)
+        return;
+
+    Load & load = _load[criterion().queue()];
+    load.required -= instructions_per_second;
+    load.misses -= branch_misprediction_per_second;
+    load.remove(this);
+}
+
+void Thread::update_cost(){
+    if(_slot == NO_SLOT)
+        return;
+
+    Load & load = _load[criterion().queue()];
+    load.required -= instructions_per_second;
+    load.misses -= branch_misprediction_per_second;
+
+    instructions_per_second = decayed(instructions_per_second, statistics().instructions_retired * 1000000ULL / criterion().period());
+    branch_misprediction_per_second = decayed(branch_misprediction_per_second, statistics().branch_misprediction * 1000000ULL / criterion().period());
+
+    // The misses of a cold job beyond those of warm ones are the lines it had to bring in, i.e. the thread's footprint.
+    // Until a warm job has been measured there is no baseline to tell them apart, so footprint holds the misses of the
+    // first cold job until then (and settling() keeps the thread in place).
+    unsigned long long misses = statistics().cache_miss;
+    if(!_warmed) {
+        if(_cold)
+            footprint = misses;
+        else {
+            cache_miss_per_job = misses;
+            footprint = (footprint > misses) ? footprint - misses : 0;
+            _warmed = true;
+        }
+        _cold = false;
+    } else if(_cold) {
+        footprint = decayed(footprint, (misses > cache_miss_per_job) ? misses - cache_miss_per_job : 0);
+        _cold = false;
+    } else
+        cache_miss_per_job = decayed(cache_miss_per_job, misses);
+
+    load.required += instructions_per_second;
+    load.misses += branch_misprediction_per_second;
+}
+
+// What moving the thread costs, amortized over the time it then has to stay put: its footprint refilled from memory,
+// unless it has been off the CPU long enough for its lines to be gone anyway
+unsigned long long Thread::migration_cost(){
+    if((_state != RUNNING) && (Alarm::elapsed() - statistics().thread_last_preemption > Alarm::ticks(CACHE_HOT)))
+        return 0;
+
+    return footprint * MIGRATION_MISS_COST * (1000000ULL / MIGRATION_INTERVAL);
+}
+
+// Charges the run that has just ended on the CPU and, once the window is over, folds it into the averages (the rate is
+// only divided out then, from the whole window, so short runs are not truncated away)
+void Thread::Load::account(TSC::Time_Stamp now, unsigned long long executed, bool idle)
+{
+    instructions += executed;
+    if(!idle)
+        busy += now - dispatched;
+    dispatched = now;
+
+    TSC::Time_Stamp elapsed = now - window;
+    unsigned long long us = elapsed / (TSC::frequency() / 1000000);
+    if(us < LOAD_WINDOW)
+        return;
+
+    retired = decayed(retired, instructions * 1000000ULL / us);
+    utilization = decayed(utilization, busy * LOAD_CAPACITY / elapsed);
+    window = now;
+    busy = 0;
+    instructions = 0;
+}
+
+void Thread::lock_another(unsigned int q)
+{
+    unsigned int current = Criterion::current_queue();
+
+    if(!smp || (q == current))
+        return;
+
+    if(q > current)
+        _lock[q].acquire();
+    else { // give up the current queue to keep the ascending lock order
+        _lock[current].release();
+        _lock[q].acquire();
+        _lock[current].acquire();
+    }
+}
+
+unsigned int Thread::lock_another(Thread * t)
+{
+    // A thread only changes queues while both of them are locked, so retry if it moved before we got there
+    unsigned int q = t->_link.rank().queue();
+    lock_another(q);
+    while(t->_link.rank().queue() != q) {
+        unlock_another(q);
+        q = t->_link.rank().queue();
+        lock_another(q);
+    }
+
+    return q;
+}
+
+unsigned int Thread::lock_queue()
+{
+    CPU::int_disable();
+
+    unsigned int q = _link.rank().queue();
+    if(smp) {
+        _lock[q].acquire();
+        while(_link.rank().queue() != q) {
+            _lock[q].release();
+            q = _link.rank().queue();
+            _lock[q].acquire();
         }
     }
+
+    return q;
 }
 
-void Thread::update_cost(){
-    _cpu_instructions_per_second_required[criterion().queue()] -= instructions_per_second;
-    _cpu_branch_missprediction_per_second[criterion().queue()] -= branch_misprediction_per_second;
+// Queues served by a single CPU are preempted on that CPU
+template<>
+unsigned int Thread::preempted_cpu<1>(unsigned int q)
+{
+    return q;
+}
 
-    instructions_per_second = statistics().instructions_retired * 1000000ULL / criterion().period();
-    branch_misprediction_per_second = statistics().branch_misprediction;
+// Queues shared by several heads (e.g. GEDF) preempt the CPU running the lowest-priority thread (i.e. the latest
+// deadline), so the H highest-priority threads are the ones running. The caller must hold q's lock.
+template<unsigned int H>
+unsigned int Thread::preempted_cpu(unsigned int q)
+{
+    unsigned int head = 0;
+    for(unsigned int h = 0; h < H; h++) {
+        Thread * t = _scheduler.chosen(h);
+        if(!t) // this head's CPU is still booting
+            continue;
+        Thread * worst = _scheduler.chosen(head);
+        if(!worst || (int(t->_link.rank()) > int(worst->_link.rank())))
+            head = h;
+    }
 
-    _cpu_instructions_per_second_required[criterion().queue()] += instructions_per_second;
-    _cpu_branch_missprediction_per_second[criterion().queue()] += branch_misprediction_per_second;
+    return q * H + head;
 }
 
+void Thread::update_criterion(Criterion::Event event)
+{
+    unsigned int q = lock_queue();
+    bool local = (q == Criterion::current_queue());
+
+    db<Thread>(TRC) << "Thread::update_criterion(this=" << this << ",e=" << event << ")" << endl;
+
+    // A READY thread leaves the ready list while the criterion changes its rank (e.g., at a release that ends a demotion)
+    bool queued = (_state == READY);
+    if(queued)
+        _scheduler.remove(this);
+
+    int rank = _link.rank();
+    criterion().handle(event);
+
+    if(queued)
+        _scheduler.insert(this);
+
+    if((rank != int(_link.rank())) && preemptive && ((_state == READY) || (_state == RUNNING)))
+        reschedule(q);
+
+    if(local)
+        unlock();
+    else
+        unlock(q);
+}
+
+// The stack is taken before the queue lock, so the heap is never searched inside the scheduler's critical section
 void Thread::constructor_prologue(unsigned int stack_size)
 {
-    lock();
-    _thread_count++;
+    _stack = (stack_size == STACK_SIZE) ? reinterpret_cast<char *>(_stacks.get()) : 0;
+    if(!_stack)
+        _stack = new (SYSTEM) char[stack_size];
+    _stack_size = stack_size;
+
+    CPU::finc(_thread_count);
+    lock(_link.rank().queue()); // nobody else knows about this thread yet, so its queue cannot change
     _scheduler.insert(this);
-    _stack = new (SYSTEM) char[stack_size];
 }
 
 void Thread::constructor_epilogue(Log_Addr entry, unsigned int stack_size) {
@@ -156,19 +409,30 @@ void Thread::constructor_epilogue(Log_Addr entry, unsigned int stack_size) {
 
     criterion().handle(Criterion::CREATE);
 
-    if(preemptive && (_state == READY) && (_link.rank() != IDLE))
-        reschedule(_link.rank().queue());
-
     if(_link.rank() != IDLE && _link.rank() != MAIN)
         increase_cost();
-    
 
-    unlock();
+    unsigned int q = _link.rank().queue();
+    bool local = (q == Criterion::current_queue());
+
+    if(preemptive && (_state == READY) && (_link.rank() != IDLE))
+        reschedule(q);
+
+    if(local)
+        unlock();
+    else
+        unlock(q);
 }
 
 Thread::~Thread()
 {
-    lock();
+    // The synchronizer lock comes first in the lock order
+    CPU::int_disable();
+    Queue * waiting = _waiting;
+    if(smp && waiting)
+        waiting->lock();
+
+    unsigned int q = lock_queue();
 
     db<Thread>(TRC) << "~Thread(this=" << this
                     << ",state=" << _state
@@ -187,18 +451,18 @@ Thread::~Thread()
         break;
     case READY:
         _scheduler.remove(this);
-        _thread_count--;
+        CPU::fdec(_thread_count);
         break;
     case SUSPENDED:
         _scheduler.resume(this);
         _scheduler.remove(this);
-        _thread_count--;
+        CPU::fdec(_thread_count);
         break;
     case WAITING:
         _waiting->remove(this);
         _scheduler.resume(this);
         _scheduler.remove(this);
-        _thread_count--;
+        CPU::fdec(_thread_count);
         break;
     case FINISHING: // Already called exit()
         break;
@@ -206,25 +470,60 @@ Thread::~Thread()
 
     _task->dismiss(this);
 
-    if (_joining)
-        _joining->resume();
+    Thread * joining = _joining;
+    _joining = 0;
+
+    unlock_queue(q);
+    if(smp && waiting)
+        waiting->unlock();
+    if(_not_booting)
+        CPU::int_enable();
+
+    if(joining)
+        joining->resume();
+
+    if((_stack_size != STACK_SIZE) || !_stacks.put(_stack))
+        delete [] _stack;
+}
+
+PMU::Count Thread::pmu(PMU::Channel channel)
+{
+    lock();
+
+    // A thread running on this CPU has its latest counts still in the PMU (see dispatch())
+    PMU::Count count = PMU::count(&_pmu, channel, this == running());
 
     unlock();
 
-    delete _stack;
+    return count;
 }
 
-void Thread::priority(Criterion c)
+PMU::Count Thread::pmu_estimate(unsigned int i)
 {
     lock();
 
+    PMU::Count count = PMU::estimate(&_pmu, i);
+
+    unlock();
+
+    return count;
+}
+
+void Thread::priority(Criterion c)
+{
     db<Thread>(TRC) << "Thread::priority(this=" << this << ",prio=" << c << ")" << endl;
 
-    unsigned long old_cpu = _link.rank().queue();
-    unsigned long new_cpu = c.queue();
+    unsigned int old_queue;
+    unsigned int new_queue = c.queue();
+    for(;;) {
+        old_queue = _link.rank().queue();
+        lock(old_queue, new_queue);
+        if(_link.rank().queue() == old_queue)
+            break;
+        unlock(old_queue, new_queue);
+    }
 
     if(_state != RUNNING) { // reorder the scheduling queue
-
         _scheduler.suspend(this);
         _link.rank(c);
         _scheduler.resume(this);
@@ -232,17 +531,27 @@ void Thread::priority(Criterion c)
     else
         _link.rank(c);
 
+    bool local = false;
     if(preemptive) {
     	if(smp) {
-    	    if(old_cpu != CPU::id())
-    	        reschedule(old_cpu);
-    	    if(new_cpu != CPU::id())
-    	        reschedule(new_cpu);
+    	    unsigned int current = Criterion::current_queue();
+    	    if(old_queue != current)
+    	        reschedule(old_queue);
+    	    if((new_queue != current) && (new_queue != old_queue))
+    	        reschedule(new_queue);
+    	    local = (old_queue == current) || (new_queue == current);
     	} else
     	    reschedule();
     }
 
-    unlock();
+    unlock(old_queue, new_queue);
+
+    // Local rescheduling must not happen while holding the lock of another queue
+    if(local) {
+        lock();
+        reschedule();
+        unlock();
+    }
 }
 
 int Thread::join()
@@ -257,18 +566,23 @@ int Thread::join()
     // Precondition: a single joiner
     assert(!_joining);
 
+    unsigned int q = lock_another(this);
+
     if (_state != FINISHING)
     {
         Thread *prev = running();
 
         _joining = prev;
+        unlock_another(q); // from now on, exit() will have to lock our queue to resume us
+
         prev->_state = SUSPENDED;
         _scheduler.suspend(prev); // implicitly choose() if suspending chosen()
 
         Thread *next = _scheduler.chosen();
 
         dispatch(prev, next);
-    }
+    } else
+        unlock_another(q);
 
     unlock();
 
@@ -282,7 +596,9 @@ void Thread::pass()
     db<Thread>(TRC) << "Thread::pass(this=" << this << ")" << endl;
 
     Thread *prev = running();
+    unsigned int q = lock_another(this);
     Thread *next = _scheduler.choose(this);
+    unlock_another(q);
 
     if (next)
         dispatch(prev, next, false);
@@ -300,8 +616,12 @@ void Thread::suspend()
 
     Thread *prev = running();
 
+    unsigned int q = lock_another(this);
     _state = SUSPENDED;
     _scheduler.suspend(this);
+    if(preemptive && (q != Criterion::current_queue()))
+        reschedule(q);
+    unlock_another(q);
 
     Thread *next = _scheduler.chosen();
 
@@ -312,7 +632,8 @@ void Thread::suspend()
 
 void Thread::resume()
 {
-    lock();
+    unsigned int q = lock_queue();
+    bool local = (q == Criterion::current_queue());
 
     db<Thread>(TRC) << "Thread::resume(this=" << this << ")" << endl;
 
@@ -320,13 +641,16 @@ void Thread::resume()
         _state = READY;
         _scheduler.resume(this);
         if(preemptive)
-            reschedule(_link.rank().queue());
+            reschedule(q);
     } else
 
         db<Thread>(WRN) << "Resume called for unsuspended object!" << endl;
 
 
-    unlock();
+    if(local)
+        unlock();
+    else
+        unlock(q);
 }
 
 void Thread::yield()
@@ -336,7 +660,9 @@ void Thread::yield()
     db<Thread>(TRC) << "Thread::yield(running=" << running() << ")" << endl;
 
     Thread *prev = running();
+    unsigned int q = lock_another(prev); // prev might be moving to another queue
     Thread *next = _scheduler.choose_another();
+    unlock_another(q);
 
     dispatch(prev, next);
 
@@ -350,19 +676,27 @@ void Thread::exit(int status)
     db<Thread>(TRC) << "Thread::exit(status=" << status << ") [running=" << running() << "]" << endl;
 
     Thread *prev = running();
+    unsigned int q = lock_another(prev); // prev might be moving to another queue
     _scheduler.remove(prev);
     prev->_state = FINISHING;
     *reinterpret_cast<int *>(prev->_stack) = status;
     prev->criterion().handle(Criterion::FINISH);
     prev->decrease_cost();
+    unlock_another(q);
 
-    _thread_count--;
+    CPU::fdec(_thread_count);
 
     if (prev->_joining)
     {
-        prev->_joining->_state = READY;
-        _scheduler.resume(prev->_joining);
+        Thread * joining = prev->_joining;
         prev->_joining = 0;
+
+        q = lock_another(joining);
+        joining->_state = READY;
+        _scheduler.resume(joining);
+        if(preemptive && (q != Criterion::current_queue()))
+            reschedule(q);
+        unlock_another(q);
     }
 
     Thread *next = _scheduler.choose(); // at least idle will always be there
@@ -376,38 +710,56 @@ void Thread::sleep(Queue *q)
 {
     db<Thread>(TRC) << "Thread::sleep(running=" << running() << ",q=" << q << ")" << endl;
 
-    assert(locked()); // locking handled by caller
+    assert(CPU::int_disabled()); // q's locking handled by caller
+
+    if(smp)
+        _lock[Criterion::current_queue()].acquire();
 
     Thread *prev = running();
     _scheduler.suspend(prev);
     prev->_state = WAITING;
     prev->_waiting = q;
 
-
     q->insert(&prev->_link);
 
+    // Let other CPUs wake us up while we dispatch, they will wait for our queue's lock
+    if(smp)
+        q->unlock();
+
     Thread *next = _scheduler.chosen();
 
     dispatch(prev, next);
+
+    if(smp) {
+        unlock_queue(Criterion::current_queue());
+        q->lock();
+    }
 }
 
 void Thread::wakeup(Queue *q)
 {
     db<Thread>(TRC) << "Thread::wakeup(running=" << running() << ",q=" << q << ")" << endl;
 
-    assert(locked()); // locking handled by caller
+    assert(CPU::int_disabled()); // q's locking handled by caller
 
     if (!q->empty())
     {
         Thread *t = q->remove()->object();
+
+        unsigned int queue = t->lock_queue();
         t->_state = READY;
         t->_waiting = 0;
-
         _scheduler.resume(t);
+        unsigned int cpu = preempted_cpu(queue);
+        unlock_queue(queue);
 
-        if(preemptive)
-            reschedule(t->_link.rank().queue());
-
+        // We cannot dispatch while holding q's lock, so even the local CPU gets an IPI
+        if(preemptive) {
+            if(smp)
+                IC::ipi(cpu, IC::INT_RESCHEDULER);
+            else
+                reschedule();
+        }
     }
 }
 
@@ -415,23 +767,29 @@ void Thread::wakeup_all(Queue *q)
 {
     db<Thread>(TRC) << "Thread::wakeup_all(running=" << running() << ",q=" << q << ")" << endl;
 
-    assert(locked()); // locking handled by caller
+    assert(CPU::int_disabled()); // q's locking handled by caller
 
     if(!q->empty()) {
-        assert(Criterion::QUEUES <= sizeof(unsigned long) * 8);
+        assert(Traits<Machine>::CPUS < sizeof(unsigned long) * 8);
         unsigned long cpus = 0;
         while(!q->empty()) {
             Thread * t = q->remove()->object();
 
+            unsigned int queue = t->lock_queue();
             t->_state = READY;
             t->_waiting = 0;
             _scheduler.resume(t);
-            cpus |= 1 << t->_link.rank().queue();
+            unlock_queue(queue);
+            // Several threads may end up preempting the same head of a shared queue, so all of its CPUs reschedule
+            cpus |= ((1UL << Criterion::HEADS) - 1) << (queue * Criterion::HEADS);
         }
         if(preemptive) {
-            for(unsigned long i = 0; i < Criterion::QUEUES; i++)
-                if(cpus & (1 << i))
-                    reschedule(i);
+            if(smp) {
+                for(unsigned long i = 0; i < Traits<Machine>::CPUS; i++)
+                    if(cpus & (1 << i))
+                        IC::ipi(i, IC::INT_RESCHEDULER);
+            } else
+                reschedule();
         }
     }
 }
@@ -444,14 +802,18 @@ void Thread::reschedule()
 
     assert(locked()); // locking handled by caller
     Thread * prev = running();
+    unsigned int q = lock_another(prev); // prev might be moving to another queue
     Thread * next = _scheduler.choose();
+    unlock_another(q);
 
     dispatch(prev, next);
 }
 
-void Thread::reschedule(unsigned int cpu)
+void Thread::reschedule(unsigned int q)
 {
-    assert(locked()); // locking handled by caller
+    assert(CPU::int_disabled()); // locking handled by caller (a remote queue's lock suffices for an IPI)
+
+    unsigned int cpu = preempted_cpu(q);
 
     if(!smp || (cpu == CPU::id()))
         reschedule();
@@ -471,6 +833,40 @@ void Thread::rescheduler(IC::Interrupt_Id i)
 void Thread::time_slicer(IC::Interrupt_Id i)
 {
     lock();
+
+    Thread * r = running();
+
+    // Multiplexed PMU events take turns on the counters at each time slice
+    PMU::rotate(&r->_pmu);
+
+    if(Traits<Governor>::enabled)
+        Governor::update();
+
+    // Budget-based criteria (e.g. CBS) account for the running thread at each time slice, so a thread that never leaves the CPU is still charged
+    if(Criterion::dynamic)
+        r->criterion().handle(Criterion::CHARGE);
+
+    // A job that exhausts its capacity is handled according to its overrun policy (dispatch() made the time slice end by then)
+    if(Criterion::enforced && r->criterion().exhausted()) {
+        db<Thread>(INF) << "Thread::time_slicer: overrun(this=" << r << ",policy=" << r->criterion().overrun() << ")" << endl;
+
+        r->criterion().handle(Criterion::OVERRUN); // DEMOTE takes effect here, since r is the chosen one and gets requeued by reschedule()
+
+        if(r->criterion().overrun() == Criterion::SUSPEND) { // resumed at the next release (see Periodic_Thread::Dynamic_Handler)
+            r->_state = SUSPENDED;
+            _scheduler.suspend(r);
+            dispatch(r, _scheduler.chosen());
+            unlock();
+            return;
+        }
+
+        if((r->criterion().overrun() == Criterion::NOTIFY) && r->criterion().overrun_handler()) {
+            unlock();
+            r->criterion().overrun_handler()();
+            lock();
+        }
+    }
+
     reschedule();
     unlock();
 }
@@ -479,29 +875,35 @@ void Thread::dispatch(Thread *prev, Thread *next, bool charge)
 {
     // "next" is not in the scheduler's queue anymore. It's already "chosen"
 
-    if (charge && Criterion::timed)
-        _timer->restart();
+    if (charge && Criterion::timed) {
+        if(Scheduler_Timer::tickless && (next->_link.rank() == IDLE) && !Criterion::stealing)
+            _timer->disarm(CPU::id()); // idle CPUs take no time-slice interrupts, unless they must keep trying to steal() (see idle())
+        else if(Criterion::enforced && next->criterion().job_budget())
+            _timer->restart(next->criterion().job_budget()); // the time slice ends no later than next's budget (see time_slicer())
+        else
+            _timer->restart();
+    }
 
     if (prev != next)
     {
 
-        PMU::stop(2);
-        PMU::stop(3);
-        PMU::stop(4);
-        
-        unsigned long long current_time = Alarm::elapsed();
-        unsigned long long instructions = PMU::read(2);
+        // prev's counts are saved before anything else runs, so they do not leak into next's
+        unsigned long long instructions = PMU::count(&prev->_pmu, 2);
+        PMU::save(&prev->_pmu);
+        instructions = PMU::count(&prev->_pmu, 2) - instructions;
 
-        if(_cpu_last_dispatch[CPU::id()] != 0){
-            unsigned long long time_between_dispatch = current_time - _cpu_last_dispatch[CPU::id()];
-            _cpu_instructions_per_second[CPU::id()] = time_between_dispatch != 0 ? instructions * (1000000ULL / time_between_dispatch) : instructions * 1000000ULL;
-        }
-        _cpu_last_dispatch[CPU::id()] = current_time;
+        _load[CPU::id()].account(TSC::time_stamp(), instructions, prev->_link.rank() == IDLE);
+
+        if(Traits<Governor>::enabled)
+            Governor::dispatch(next->_link.rank() == IDLE);
         
-        if (Criterion::dynamic)
+        if (Criterion::dynamic || Criterion::enforced)
         {
+            // Only prev's rank can change here (see LLF::handle()), so there is no need to update every thread
+            int rank = prev->_link.rank();
             prev->criterion().handle(Criterion::CHARGE | Criterion::LEAVE);
-            for_all_threads(Criterion::UPDATE);
+            if((prev->_state == RUNNING) && (rank != int(prev->_link.rank()))) // still in the ready queue
+                _scheduler.update(prev);
             next->criterion().handle(Criterion::AWARD | Criterion::ENTER);
         }
 
@@ -520,15 +922,10 @@ void Thread::dispatch(Thread *prev, Thread *next, bool charge)
         }
         db<Thread>(INF) << "Thread::dispatch:next={" << next << ",ctx=" << *next->_context << "}" << endl;
         if(smp)
-            _lock.release();
+            _lock[Criterion::current_queue()].release();
+
 
-                
-        PMU::reset(2);
-        PMU::reset(3);
-        PMU::reset(4);
-        PMU::start(2);
-        PMU::start(3);
-        PMU::start(4);
+        PMU::load(&next->_pmu);
 
         // The non-volatile pointer to volatile pointer to a non-volatile context is correct
         // and necessary because of context switches, but here, we are locked() and
@@ -538,7 +935,7 @@ void Thread::dispatch(Thread *prev, Thread *next, bool charge)
         CPU::switch_context(const_cast<Context **>(&prev->_context), next->_context);
 
         if(smp)
-            _lock.acquire();
+            _lock[Criterion::current_queue()].acquire();
     }
 }
 
@@ -546,12 +943,16 @@ int Thread::idle()
 {
     db<Thread>(TRC) << "Thread::idle(cpu=" << CPU::id() << ",this=" << running() << ")" << endl;
     change_thread_queue_if_necessary();
-    CPU::clock(Thread::calculate_frequency());
     while(_thread_count > CPU::cores()) { // someone else besides idles
         if(Traits<Thread>::trace_idle)
             db<Thread>(TRC) << "Thread::idle(cpu=" << CPU::id() << ",this=" << running() << ")" << endl;
 
 
+        if(Criterion::stealing && steal()) {
+            yield();
+            continue;
+        }
+
         CPU::int_enable();
         CPU::halt();
 
@@ -562,6 +963,11 @@ int Thread::idle()
     if(CPU::id() == CPU::BSP) {
         kout << "\n\n*** The last thread under control of EPOS has finished." << endl;
         kout << "*** EPOS is shutting down!" << endl;
+
+        if(Traits<Profiler>::enabled)
+            Profiler::dump();
+        if(Traits<Governor>::enabled)
+            Governor::dump();
     }
 
     CPU::smp_barrier();
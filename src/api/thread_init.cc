@@ -24,6 +24,14 @@ void Thread::init()
 
     Criterion::init();
 
+    _load[CPU::id()].window = _load[CPU::id()].dispatched = TSC::time_stamp();
+
+    // Fill this CPU's pools before any thread is created on it (see Pool)
+    for(unsigned int i = 0; i < Traits<Thread>::CACHED; i++) {
+        _stacks.put(new (SYSTEM) char[STACK_SIZE]);
+        _pool.put(::operator new(sizeof(Thread), SYSTEM));
+    }
+
     if(CPU::id() == CPU::BSP) {
         typedef int (Main)();
 
@@ -11,7 +11,7 @@ void CPU::init()
     db<Init, CPU>(TRC) << "CPU::init()" << endl;
 
     _cpu_clock = System::info()->tm.cpu_clock;
-    _cpu_current_clock = System::info()->tm.cpu_clock;
+    _cpu_current_clock[CPU::id()] = System::info()->tm.cpu_clock;
     _bus_clock = System::info()->tm.bus_clock;
 
     // Initialize the MMU
@@ -25,15 +25,6 @@ void CPU::init()
     // Initialize the PMU	
     if(Traits<PMU>::enabled){
         PMU::init();
-        PMU::config(2, 2);
-        PMU::start(2);
-        PMU::reset(2);
-        PMU::config(3, 15);
-        PMU::start(3);
-        PMU::reset(3);
-        PMU::config(4, 30);
-        PMU::start(4);
-        PMU::reset(4);
     }
 }
 
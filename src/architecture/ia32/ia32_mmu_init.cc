@@ -1,10 +1,24 @@
 // EPOS IA32 MMU Mediator Initialization
 
 #include <architecture/mmu.h>
+#include <utility/math.h>
 #include <system.h>
 
 __BEGIN_SYS
 
+// Gives the n frames from base to the WHITE allocator, but for those in [hole, hole_top), which are still in use
+static void release(unsigned long base, unsigned long n, unsigned long hole, unsigned long hole_top)
+{
+    unsigned long top = base + n * sizeof(MMU::Page);
+    if((hole < top) && (hole_top > base)) {
+        if(hole > base)
+            MMU::white_free(base, MMU::pages(hole - base));
+        if(top > hole_top)
+            MMU::white_free(hole_top, MMU::pages(top - hole_top));
+    } else
+        MMU::white_free(base, n);
+}
+
 void MMU::init()
 {
     db<Init, MMU>(TRC) << "MMU::init()" << endl;
@@ -20,48 +34,61 @@ void MMU::init()
     db<Init, MMU>(INF) << "MMU::free3={base=" << reinterpret_cast<void *>(si->pmm.free3_base) << ",size="
                        << (si->pmm.free3_top - si->pmm.free3_base) / 1024 << "KB}" << endl;
 
-    // BIG NOTE HERE: INIT (i.e. this program) will be part of the free
-    // storage after the following is executed, but it will remain alive
-    // This only works because the _free.insert_merging() only
-    // touches the first page of each chunk and INIT is not there
+    int f1b = si->pmm.free1_base;
+    int f1t = si->pmm.free1_top;
+    int f2b = si->pmm.free2_base;
+    int f2t = si->pmm.free2_top;
+    int f3b = si->pmm.free3_base;
+    int f3t = si->pmm.free3_top;
 
-    if(colorful) {
-        int f1b = si->pmm.free1_base;
-        int f1t = si->pmm.free1_top;
-        int f2b = si->pmm.free2_base;
-        int f2t = si->pmm.free2_top;
-        int f3b = si->pmm.free3_base;
-        int f3t = si->pmm.free3_top;
+    // The buddy allocators share a map telling which blocks are free, taken from the top of the second chunk, the
+    // largest one (frames are numbered from physical address 0)
+    unsigned long frames = pages(Math::max(f1t, f2t, f3t));
+    unsigned long map = align_page(List::map_size(frames));
+    f2t -= map;
+    memset(phy2log(f2t), 0, map);
+    for(unsigned int i = 0; i < colorful * COLORS + 1; i++)
+        _free[i].map(phy2log(f2t), phy2log(0), frames);
 
+    // INIT (i.e. this program) is loaded at its physical address, in free memory, and keeps running until Init_End. The
+    // buddy allocators write to the first frame of every free block, and INIT starts at an aligned one, so its frames
+    // are left out when it is a separate image (SETUP's, in contrast, are no longer in use)
+    unsigned long ib = 0, it = 0;
+    if(si->lm.has_ini) {
+        ib = si->lm.ini_code;
+        it = align_page(Math::max(si->lm.ini_code + si->lm.ini_code_size, si->lm.ini_data + si->lm.ini_data_size));
+    }
+
+    if(colorful) {
         // Insert a bulk of memory large enough to contain the System's heap into _free[WHITE] lists
         int size = Traits<System>::HEAP_SIZE;
         if((f1t - f1b) > size) {
-            white_free(f1b, pages(f1b + size));
+            release(f1b, pages(f1b + size), ib, it);
             f1b += size;
             size = 0;
         } else {
-            white_free(f1b, pages(f1t - f1b));
+            release(f1b, pages(f1t - f1b), ib, it);
             size -= (f1t - f1b);
             f1b = f1t = 0;
         }
         if(size > 0) {
             if((f2t - f2b) > size) {
-                white_free(f2b, pages(f2b + size));
+                release(f2b, pages(f2b + size), ib, it);
                 f2b += size;
                 size = 0;
             } else {
-                white_free(f2b, pages(f2t - f2b));
+                release(f2b, pages(f2t - f2b), ib, it);
                 size -= (f2t - f2b);
                 f2b = f2t = 0;
             }
         }
         if(size > 0) {
             if((f3t - f3b) > size) {
-                white_free(f3b, pages(f3b + size));
+                release(f3b, pages(f3b + size), ib, it);
                 f3b += size;
                 size = 0;
             } else {
-                white_free(f3b, pages(f3t - f3b));
+                release(f3b, pages(f3t - f3b), ib, it);
                 size -= (f3t - f3b);
                 f3b = f3t = 0;
             }
@@ -72,28 +99,33 @@ void MMU::init()
         // Insert the remaining free memory into the _free[color] lists
         int frame = f1b;
         while(frame < f1t) {
-            free(frame);
+            if((frame < int(ib)) || (frame >= int(it)))
+                free(frame);
             frame += sizeof(Page);
         }
 
         frame = f2b;
         while(frame < f2t) {
-            free(frame);
+            if((frame < int(ib)) || (frame >= int(it)))
+                free(frame);
             frame += sizeof(Page);
         }
 
         frame = f3b;
         while(frame < f3t) {
-            free(frame);
+            if((frame < int(ib)) || (frame >= int(it)))
+                free(frame);
             frame += sizeof(Page);
         }
     } else {
         // Insert all free memory into the _free[WHITE] list
-        free(si->pmm.free1_base, pages(si->pmm.free1_top - si->pmm.free1_base));
-        free(si->pmm.free2_base, pages(si->pmm.free2_top - si->pmm.free2_base));
-        free(si->pmm.free3_base, pages(si->pmm.free3_top - si->pmm.free3_base));
+        release(f1b, pages(f1t - f1b), ib, it);
+        release(f2b, pages(f2t - f2b), ib, it);
+        release(f3b, pages(f3t - f3b), ib, it);
     }
 
+    db<Init, MMU>(INF) << "MMU::free=" << free_frames() * sizeof(Page) / 1024 << "KB,largest=" << allocable() * sizeof(Page) / 1024 << "KB" << endl;
+
     // Remember the master page directory (created during SETUP)
     _master = current();
     db<Init, MMU>(INF) << "MMU::master page directory=" << _master << endl;
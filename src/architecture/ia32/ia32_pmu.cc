@@ -1,55 +1,248 @@
 // EPOS IA32 PMU Mediator Implementation
 
 #include <architecture/ia32/ia32_pmu.h>
+#include <architecture/tsc.h>
 
 __BEGIN_SYS
 
+PMU::Event PMU::_programmed[Traits<Machine>::CPUS][CHANNELS];
+PMU::Event PMU::_sampled[CHANNELS];
+PMU::Count PMU::_period[CHANNELS];
+PMU::Overflow_Handler * PMU::_overflow;
+volatile unsigned int PMU::_sampling;
+unsigned int PMU::_armed[Traits<Machine>::CPUS];
+
+PMU::Context::Context(const Event * events, const Event * mux)
+: multiplexed(0), first(0), group(0), since(0), running(0)
+{
+    for(Channel c = 0; c < CHANNELS; c++) {
+        count[c] = 0;
+        if(!events)
+            event[c] = (c < FIXED) ? c : UNUSED;
+        else if((events[c] != UNUSED) && (!supported(events[c]) || ((c < FIXED) && (events[c] != c)))) {
+            db<PMU>(WRN) << "PMU::Context: event " << events[c] << " cannot be counted on channel " << c << "!" << endl;
+            event[c] = UNUSED;
+        } else
+            event[c] = events[c];
+    }
+
+    if(!events) {
+        if((FIXED < CHANNELS) && supported(PMU_Event::BRANCH_MISPREDICTIONS))
+            event[FIXED] = PMU_Event::BRANCH_MISPREDICTIONS;
+        if((FIXED + 1 < CHANNELS) && supported(PMU_Event::L3_CACHE_MISSES))
+            event[FIXED + 1] = PMU_Event::L3_CACHE_MISSES;
+    }
+
+    for(unsigned int i = 0; mux && (mux[i] != UNUSED); i++) {
+        if((i >= MULTIPLEXED) || !supported(mux[i])) {
+            db<PMU>(WRN) << "PMU::Context: event " << mux[i] << " cannot be multiplexed!" << endl;
+            break;
+        }
+        mux_event[i] = mux[i];
+        mux_count[i] = 0;
+        enabled[i] = 0;
+        multiplexed++;
+    }
+}
+
+void PMU::save(Context * ctx)
+{
+    db<PMU>(TRC) << "PMU::save(ctx=" << ctx << ")" << endl;
+
+    unsigned int armed = _armed[CPU::id()];
+
+    // Counters are stopped but not reset, so the criterion can still read the last slice at LEAVE (see RT_Common::handle())
+    for(Channel c = 0; c < CHANNELS; c++)
+        if((ctx->event[c] != UNUSED) && !(armed & (1 << c))) {
+            stop(c);
+            ctx->count[c] += read(c);
+        }
+
+    fold(ctx);
+}
+
+void PMU::load(Context * ctx)
+{
+    db<PMU>(TRC) << "PMU::load(ctx=" << ctx << ")" << endl;
+
+    unsigned int cpu = CPU::id();
+    Event * programmed = _programmed[cpu];
+
+    // Channels armed for sampling are left alone, and are armed here on CPUs that have not armed them yet
+    if(_armed[cpu] != _sampling)
+        sample();
+
+    // Multiplexed events take the programmable channels the thread does not count on, starting from the current group (see rotate()).
+    // Channels left unused are cleared anyway, so no counts leak from the previous thread.
+    ctx->group = 0;
+    for(Channel c = 0; c < CHANNELS; c++) {
+        if(_armed[cpu] & (1 << c))
+            continue;
+
+        Event event = ctx->event[c];
+        if((event == UNUSED) && (c >= FIXED) && (ctx->group < ctx->multiplexed)) {
+            event = ctx->mux_event[(ctx->first + ctx->group) % ctx->multiplexed];
+            ctx->mux_channel[ctx->group++] = c;
+        }
+
+        if((event != UNUSED) || (programmed[c] != UNUSED))
+            program(c, event);
+    }
+
+    ctx->since = TSC::time_stamp();
+}
+
+void PMU::rotate(Context * ctx)
+{
+    // Nothing to rotate if all multiplexed events fit in the channels (or none does)
+    if(!ctx->group || (ctx->group >= ctx->multiplexed))
+        return;
+
+    db<PMU>(TRC) << "PMU::rotate(ctx=" << ctx << ",first=" << ctx->first << ")" << endl;
+
+    fold(ctx);
+
+    ctx->first = (ctx->first + ctx->group) % ctx->multiplexed;
+    for(unsigned int i = 0; i < ctx->group; i++)
+        program(ctx->mux_channel[i], ctx->mux_event[(ctx->first + i) % ctx->multiplexed]);
+
+    ctx->since = TSC::time_stamp();
+}
+
+// Accumulates the counts of the current group of multiplexed events and the time they have been counted
+void PMU::fold(Context * ctx)
+{
+    unsigned int armed = _armed[CPU::id()];
+    Count elapsed = TSC::time_stamp() - ctx->since;
+
+    ctx->running += elapsed;
+    for(unsigned int i = 0; i < ctx->group; i++) {
+        Channel c = ctx->mux_channel[i];
+        if(armed & (1 << c)) // taken for sampling since the group was loaded
+            continue;
+
+        unsigned int e = (ctx->first + i) % ctx->multiplexed;
+        stop(c);
+        ctx->mux_count[e] += read(c);
+        ctx->enabled[e] += elapsed;
+    }
+}
+
+void PMU::program(Channel channel, Event event)
+{
+    Event * programmed = _programmed[CPU::id()];
+
+    reset(channel);
+    if(event == UNUSED) {
+        stop(channel);
+        programmed[channel] = UNUSED;
+    } else if(event != programmed[channel]) {
+        config(channel, event); // also starts the channel
+        programmed[channel] = event;
+    } else
+        start(channel);
+}
+
+bool PMU::arm(Channel channel, Event event, Count period, Overflow_Handler * handler)
+{
+    db<PMU>(TRC) << "PMU::arm(c=" << channel << ",e=" << event << ",p=" << period << ",h=" << reinterpret_cast<void *>(handler) << ")" << endl;
+
+    // Counters are reloaded with -period at each overflow, and writes to them are sign-extended from 32 bits
+    if((channel < FIXED) || (channel >= CHANNELS) || !supported(event) || !period || (period > 0x7fffffff)) {
+        db<PMU>(WRN) << "PMU::arm: channel " << channel << " cannot sample event " << event << " every " << period << " events!" << endl;
+        return false;
+    }
+
+    if(!Traits<System>::multicore) {
+        db<PMU>(WRN) << "PMU::arm: overflow interrupts are delivered by the local APIC, which EPOS only sets up for multicore configurations!" << endl;
+        return false;
+    }
+
+    bool disabled = CPU::int_disabled();
+    CPU::int_disable();
+
+    if(_sampling & (1 << channel)) {
+        if(!disabled)
+            CPU::int_enable();
+        db<PMU>(WRN) << "PMU::arm: channel " << channel << " is already armed!" << endl;
+        return false;
+    }
+
+    if(!_sampling)
+        IC::int_vector(IC::INT_PMU, int_handler);
+
+    _sampled[channel] = event;
+    _period[channel] = period;
+    _overflow = handler;
+    _sampling |= 1 << channel;
+    sample();
+
+    if(!disabled)
+        CPU::int_enable();
+
+    return true;
+}
+
+void PMU::disarm(Channel channel)
+{
+    db<PMU>(TRC) << "PMU::disarm(c=" << channel << ")" << endl;
+
+    bool disabled = CPU::int_disabled();
+    CPU::int_disable();
+
+    _sampling &= ~(1 << channel);
+    sample();
+
+    if(!disabled)
+        CPU::int_enable();
+}
+
+// Brings the channels armed on this CPU in line with the system-wide set (called with interrupts disabled)
+void PMU::sample()
+{
+    unsigned int cpu = CPU::id();
+
+    for(Channel c = FIXED; c < CHANNELS; c++) {
+        unsigned int bit = 1 << c;
+        if((_sampling & bit) && !(_armed[cpu] & bit)) {
+            stop(c);
+            write(c, Count(0) - _period[c]);
+            config(c, _sampled[c], Flags(INT)); // also starts the channel
+            _armed[cpu] |= bit;
+        } else if(!(_sampling & bit) && (_armed[cpu] & bit)) {
+            stop(c);
+            reset(c);
+            _armed[cpu] &= ~bit;
+        } else
+            continue;
+        _programmed[cpu][c] = UNUSED; // threads counting on this channel will reprogram it (see load())
+    }
+
+    if(_armed[cpu]) {
+        APIC::config_pmu(IC::INT_PMU);
+        APIC::enable_pmu();
+    } else
+        APIC::disable_pmu();
+}
+
 void PMU::int_handler(Interrupt_Id i)
 {
-//
-//        //db< Init, Intel_PMU_V1 >(WRN) << "Intel_PMU_V1::PMU_int_handler()\n";
-//
-//        Reg64 perf_ovf_msr;// pebs_enable_msr, pmcs_enable_msr;
-//
-//        // Get overflow status register value
-//        perf_ovf_msr = global_overflow_status();
-//        // kout << read(FIXED) << "    canal:FIXED   cpu:" << "  overflow:" << overflow() << "   thread:" << endl;
-//
-//        // PMC Handlers
-//        if(overflow())
-//        {
-//           // kout << "OVERFLOW" << endl;
-//
-//            for(Channel i=0; i<CHANNELS;i++)
-//            {
-//                if(perf_ovf_msr&(1ULL << i))
-//                {
-//                    stop(i+FIXED);
-//                    clear_overflow(i+FIXED);
-//                    start(i+FIXED);
-//                }
-//            }
-//
-//            db<Init, Intel_PMU_V1>(INF) << "Intel_PMU_V1::PMC_overflow(" << APIC::id() << ");" << endl;
-//        }
-//
-//        // Overflow Changed flag
-//        clear_cond_changed();
-//
-//        // Clearing the mask bit in the performance counter LVT entry.
-//        APIC::enable_perf();
-//        // kout << read(FIXED) << "    canal:FIXED   cpu:"  << "  overflow:" << overflow() << "   thread:" << endl;
-//
-//        for(Reg32 i = 0; i < CHANNELS; i++)
-//        {
-//            // For each PMC: verify if it's handler is set and an overflow occurred
-//            if((_pmc_handler[i] != 0) && ((perf_ovf_msr&(1ULL << i)) != 0))
-//            {
-//                // Then, call this handler
-//                _pmc_handler[i]();
-//            }
-//        }
-//        // kout << read(FIXED) << "    canal:FIXED   cpu:" << "  overflow:" << overflow() << "   thread:" << endl;
+    unsigned int cpu = CPU::id();
+    Reg64 status = rdmsr(GLOBAL_STATUS);
+    void * ip = IC::interrupted()->ip();
+
+    for(Channel c = FIXED; c < CHANNELS; c++)
+        if((_armed[cpu] & (1 << c)) && (status & (1ULL << (PMC0_OVERFLOW + c - FIXED)))) {
+            write(c, Count(0) - _period[c]);
+            if(_overflow)
+                _overflow(c, ip);
+        }
+
+    wrmsr(GLOBAL_OVF, status);
+
+    // INT_PMU is not a hardware IRQ, so IC::dispatch() does not acknowledge it, and the APIC masks its LVT entry at each delivery
+    APIC::eoi(i);
+    APIC::enable_pmu();
 }
 
 __END_SYS
@@ -8,6 +8,10 @@ void PMU::init()
 {
     db<Init, PMU>(TRC) << "PMU::init()" << endl;
 
+    // Channels are programmed on demand, as threads are dispatched (see load())
+    for(Channel c = 0; c < CHANNELS; c++)
+        _programmed[CPU::id()][c] = UNUSED;
+
     // Check if the CPU supports CPUID
     CPU::flags(CPU::flags() | CPU::FLAG_ID);
     if(!(CPU::flags() & CPU::FLAG_ID)) {
@@ -19,9 +19,8 @@ const Intel_Sandy_Bridge_PMU::Event Intel_Sandy_Bridge_PMU::_events[EVENTS] = {
     UNSUPORTED_EVENT,                   // ATOMIC_MEMEMORY_INSTRUCTIONS_RETIRED,
 
     BRANCH_INSTRUCTIONS_RETIRED,        // BRANCHES,
-    BR_INST_EXEC_COND,                  // CONDITIONAL_BRANCHES,         // for some architectures BRANCHES = IMIDIATE + CONDITIONAL
-    UNSUPORTED_EVENT,                   // PREDICTABLE_BRANCHES,
-    UNSUPORTED_EVENT,                   // IMIDIATE_BRANCHES,
+    UNSUPORTED_EVENT,                   // IMMEDIATE_BRANCHES,
+    BR_INST_EXEC_COND,                  // CONDITIONAL_BRANCHES,         // for some architectures BRANCHES = IMMEDIATE + CONDITIONAL
     BRANCH_MISSES_RETIRED,              // BRANCH_MISPREDICTIONS,
     UNSUPORTED_EVENT,                   // BRANCH_DIRECTION_MISPREDICTIONS,
     BR_MISP_RETIRED_CONDITIONAL,        // CONDITIONAL_BRANCH_MISPREDICTIONS,
@@ -41,6 +40,7 @@ const Intel_Sandy_Bridge_PMU::Event Intel_Sandy_Bridge_PMU::_events[EVENTS] = {
     LLC_REFERENCES,                     // L3_CACHE_HITS,
     LLC_MISSES,                         // L3_CACHE_MISSES,
 
+    UNSUPORTED_EVENT,                   // INSTRUCTION_MEMORY_ACCESSES,
     UNSUPORTED_EVENT,                   // UNCACHED_MEMORY_ACCESSES,
     UNSUPORTED_EVENT,                   // UNALIGNED_MEMORY_ACCESSES,
 
@@ -41,6 +41,10 @@ public:
         if(Traits<Timer>::enabled)
             Timer::reset();
 
+        // Counters are otherwise loaded at each dispatch
+        if(Traits<PMU>::enabled)
+            PMU::load(&first->_pmu);
+
         first->_context->load();
     }
 };
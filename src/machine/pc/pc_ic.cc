@@ -11,6 +11,7 @@ __BEGIN_SYS
 
 APIC::Log_Addr APIC::_base;
 IC::Interrupt_Handler IC::_int_vector[IC::INTS];
+CPU::Context * volatile IC::_interrupted[Traits<Machine>::CPUS];
 
 // This function has to be here (and not in pc_ic_init.cc) because it is used by SETUP, which cannot be linked against libinit.a
 void APIC::ipi_init(volatile int * status)
@@ -67,6 +68,9 @@ void APIC::ipi(unsigned int cpu, unsigned int interrupt)
 
 void IC::dispatch(unsigned int i)
 {
+    // entry() pushed the interrupted context (registers, then IP, CS and FLAGS) right before calling us
+    _interrupted[CPU::id()] = reinterpret_cast<CPU::Context *>(reinterpret_cast<char *>(__builtin_frame_address(0)) + 2 * sizeof(long));
+
     bool not_spurious = true;
     if((i >= INT_FIRST_HARD) && (i <= INT_LAST_HARD))
         not_spurious = eoi(i);
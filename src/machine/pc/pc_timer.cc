@@ -6,17 +6,46 @@
 __BEGIN_SYS
 
 Timer * Timer::_channels[CHANNELS];
+Timer::Time_Stamp Timer::_tsc_base;
+Timer::Time_Stamp Timer::_tsc_per_tick;
 
 void Timer::int_handler(Interrupt_Id i)
 {
+    if(tickless) {
+        // The timer is reprogrammed before any handler runs, since handlers might not return soon (e.g. the scheduler's)
+        Time_Stamp now = TSC::time_stamp();
+        Timer * expired[CHANNELS];
+        for(unsigned int c = 0; c < CHANNELS; c++) {
+            Timer * t = _channels[c];
+            unsigned int cpu = owner(c, CPU::id());
+            expired[c] = 0;
+            if(t && (cpu == CPU::id()) && t->_expiration[cpu] && (t->_expiration[cpu] <= now)) {
+                expired[c] = t;
+                t->_expiration[cpu] = (t->_retrigger) ? t->_expiration[cpu] + t->_initial * _tsc_per_tick : 0;
+            }
+        }
+        program();
+
+        // Same order as the periodic case below, with the scheduler last
+        if(expired[USER])
+            expired[USER]->_handler(i);
+        if(expired[ALARM])
+            expired[ALARM]->_handler(i);
+        if(expired[SCHEDULER])
+            expired[SCHEDULER]->_handler(i);
+
+        return;
+    }
+
     if((CPU::id() == CPU::BSP) && _channels[USER] && (--_channels[USER]->_current[CPU::BSP] <= 0)) {
         if(_channels[USER]->_retrigger)
             _channels[USER]->_current[CPU::BSP] = _channels[USER]->_initial;
         _channels[USER]->_handler(i);
     }
 
-    if((CPU::id() == CPU::BSP) && _channels[ALARM] && (--_channels[ALARM]->_current[CPU::BSP] <= 0)) {
-        _channels[ALARM]->_current[CPU::BSP] = _channels[ALARM]->_initial;
+    // Each CPU drives the alarms of its own scheduling queue (see Alarm::handler())
+    if(_channels[ALARM] && (--_channels[ALARM]->_current[CPU::id()] <= 0)) {
+        _channels[ALARM]->_current[CPU::id()] = _channels[ALARM]->_initial;
         _channels[ALARM]->_handler(i);
     }
 
@@ -26,4 +55,30 @@ void Timer::int_handler(Interrupt_Id i)
     }
 }
 
+void Timer::program()
+{
+    Time_Stamp next = 0;
+    for(unsigned int c = 0; c < CHANNELS; c++) {
+        unsigned int cpu = owner(c, CPU::id());
+        if(_channels[c] && (cpu == CPU::id()) && _channels[c]->_expiration[cpu] && (!next || (_channels[c]->_expiration[cpu] < next)))
+            next = _channels[c]->_expiration[cpu];
+    }
+
+    // Nothing to expire on this CPU, so no interrupts at all
+    if(!next) {
+        Engine::config(0, 0, false, false);
+        return;
+    }
+
+    // The engine counts bus cycles (in steps of 16 for the APIC)
+    Time_Stamp now = TSC::time_stamp();
+    Time_Stamp count = (next > now) ? (next - now) * (Engine::clock() / FREQUENCY) / _tsc_per_tick : 0;
+    if(count < 16)
+        count = 16;
+    if(count > Count(~0))
+        count = Count(~0);
+
+    Engine::config(0, count, true, false);
+}
+
 __END_SYS
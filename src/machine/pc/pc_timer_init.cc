@@ -11,9 +11,15 @@ void Timer::init()
 
     CPU::int_disable();
 
-    if(CPU::id() == CPU::BSP)
+    if(CPU::id() == CPU::BSP) {
         IC::int_vector(IC::INT_SYS_TIMER, int_handler);
 
+        if(tickless) {
+            _tsc_base = TSC::time_stamp();
+            _tsc_per_tick = TSC::frequency() / FREQUENCY;
+        }
+    }
+
     disable();
     reset();
     enable();
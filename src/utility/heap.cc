@@ -9,4 +9,9 @@ void Heap_Imp::out_of_memory(unsigned long bytes)
     db<Heaps, System>(ERR) << "Heap::alloc(this=" << this << "): out of memory while allocating " << bytes << " bytes!" << endl;
 }
 
+void TLSF_Heap::out_of_memory(unsigned long bytes)
+{
+    db<Heaps, System>(ERR) << "Heap::alloc(this=" << this << "): out of memory while allocating " << bytes << " bytes!" << endl;
+}
+
 __END_UTIL
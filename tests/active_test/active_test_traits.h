@@ -46,6 +46,10 @@ template<> struct Traits<Spin>: public Traits<Build>
 template<> struct Traits<Heaps>: public Traits<Build>
 {
     static const bool debugged = hysterically_debugged;
+    enum {FIRST_FIT, TLSF};
+    static const unsigned int ALLOCATOR = FIRST_FIT;  // TLSF: O(1) alloc() and free(), for bounded latency
+    static const unsigned int MAGAZINE = 16;           // blocks of each small size each CPU keeps in front of the heap (multicore only, 0 disables)
+    static const unsigned int POOLED = 8;              // Alarms, Semaphores and Segments each CPU keeps for reuse (0 disables)
 };
 
 template<> struct Traits<Observers>: public Traits<Build>
@@ -120,6 +124,7 @@ template<> struct Traits<Thread>: public Traits<Build>
 
     typedef IF<(CPUS > 1), GRR, RR>::Result Criterion;
     static const unsigned int QUANTUM = 1000; // us
+    static const unsigned int CACHED = 2; // stacks and Thread objects each CPU keeps ready (see Pool)
 };
 
 template<> struct Traits<Scheduler<Thread>>: public Traits<Build>
@@ -137,6 +142,38 @@ template<> struct Traits<Alarm>: public Traits<Build>
     static const bool visible = hysterically_debugged;
 };
 
+template<> struct Traits<Profiler>: public Traits<Build>
+{
+    static const bool enabled = false;
+    static const unsigned int SAMPLES = 1024; // per CPU
+};
+
+template<> struct Traits<Governor>: public Traits<Build>
+{
+    static const bool enabled = false;
+    enum {PERFORMANCE, POWERSAVE, ONDEMAND, DEADLINE};
+    static const unsigned int POLICY = ONDEMAND;
+    static const unsigned int PERIOD = 10000;           // us between decisions on each CPU
+    static const unsigned int SMOOTHING = 2;            // the load is averaged as l = l - l / 2^SMOOTHING + sample / 2^SMOOTHING
+    static const unsigned int UP_THRESHOLD = 80;        // ONDEMAND: load (%) above which the CPU goes to max_clock()
+    static const unsigned int HYSTERESIS = 5;           // clocks are only lowered by more than this (% of max_clock())
+    static const unsigned int TRACE = 64;               // clock changes kept per CPU
+};
+
+template<> struct Traits<Executor>: public Traits<Build>
+{
+    static const bool enabled = false;
+    static const unsigned int WORKERS_PER_CPU = 1;
+    static const unsigned int DEQUE_SIZE = 64;          // submissions each worker (and each CPU's inbox) can hold, a power of 2
+    static const unsigned int STACK_SIZE = Traits<Application>::STACK_SIZE;
+};
+
+template<> struct Traits<Coroutine>: public Traits<Build>
+{
+    static const unsigned int RESOLUTION = 1000;        // us per tick of CO_DELAY() and CO_WAIT_NEXT()
+    static const unsigned int STACK_SIZE = Traits<Application>::STACK_SIZE; // of each CPU's run loop
+};
+
 template<> struct Traits<Address_Space>: public Traits<Build> {};
 
 template<> struct Traits<Segment>: public Traits<Build> {};
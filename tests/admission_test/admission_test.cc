@@ -0,0 +1,74 @@
+// EPOS Admission Control Test Program
+
+#include <time.h>
+#include <real-time.h>
+
+using namespace EPOS;
+
+const unsigned int iterations = 10;
+const unsigned int threads = 5;
+const Milisecond period[threads]   = {100,  80, 60, 200, 50};
+const Milisecond deadline[threads] = {  0,   0,  0,  40,  0};
+const Milisecond wcet[threads]     = { 30,  20, 30,  20, 10};
+
+int func(unsigned int n);
+
+OStream cout;
+
+Periodic_Thread * thread[threads];
+
+int main()
+{
+    cout << "Admission Control Test" << endl;
+
+    cout << "\nThis test tries to create " << threads << " periodic threads under RM, admitting each of them only if the response-time analysis"
+         << " shows that all deadlines will still be met:" << endl;
+    for(unsigned int i = 0; i < threads; i++)
+        cout << "- Thread " << char('A' + i) << ": p=" << period[i] << "ms, d=" << (deadline[i] ? deadline[i] : period[i]) << "ms, c=" << wcet[i] << "ms;" << endl;
+    cout << "C pushes the utilization above 1 and D's deadline is shorter than the response time it would have, so both must be rejected." << endl;
+
+    unsigned int admitted = 0;
+    for(unsigned int i = 0; i < threads; i++) {
+        thread[i] = Periodic_Thread::admit(RTConf(period[i] * 1000, deadline[i] * 1000, wcet[i] * 1000, 0, iterations), &func, i);
+        cout << "Thread " << char('A' + i) << (thread[i] ? " admitted" : " rejected") << endl;
+        if(thread[i])
+            admitted++;
+    }
+
+    cout << "\nPartitioning the same set offline with first-fit decreasing utilization: " << endl;
+    Admission_Control::Task task[threads];
+    for(unsigned int i = 0; i < threads; i++)
+        task[i] = Admission_Control::Task(period[i] * 1000, deadline[i] * 1000, wcet[i] * 1000);
+    bool ok = Admission_Control::partition(task, threads);
+    for(unsigned int i = 0; i < threads; i++) {
+        cout << "Thread " << char('A' + i) << " => ";
+        if(task[i].queue == Admission_Control::NONE)
+            cout << "none" << endl;
+        else
+            cout << "queue " << task[i].queue << endl;
+    }
+    cout << "The set " << (ok ? "fits" : "does not fit") << " on top of the " << admitted << " threads already admitted (it shouldn't, for they already take most of the CPU)." << endl;
+
+    cout << "\nWaiting for the admitted threads to finish..." << endl;
+    for(unsigned int i = 0; i < threads; i++)
+        if(thread[i])
+            cout << "Thread " << char('A' + i) << " exited with status \"" << char(thread[i]->join()) << "\" after " << thread[i]->statistics().jobs_finished << " jobs." << endl;
+
+    cout << "I'm also done, bye!" << endl;
+
+    return 0;
+}
+
+int func(unsigned int n)
+{
+    Chronometer chrono;
+
+    do {
+        chrono.reset();
+        chrono.start();
+        while(chrono.read() < wcet[n] * 1000 / 2); // half of the WCET, to stay clear of the deadlines
+        chrono.stop();
+    } while (Periodic_Thread::wait_next());
+
+    return 'A' + n;
+}
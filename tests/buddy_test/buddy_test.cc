@@ -0,0 +1,174 @@
+// EPOS Buddy Allocator Test Program
+
+#include <time.h>
+#include <utility/buddy.h>
+#include <utility/list.h>
+#include <utility/random.h>
+
+using namespace EPOS;
+
+const unsigned int SHIFT = 8;                   // frames of 256 bytes, to keep the arena small
+const unsigned int ORDERS = 11;
+const unsigned int FRAMES = 1024;
+const unsigned int SLOTS = 128;                 // runs allocated at once, at most
+const unsigned int OPERATIONS = 20000;
+const unsigned int SMALL = 8;                   // most runs are up to this long
+const unsigned int LARGE = 64;                  // and one in eight up to this
+const unsigned int ORDER = 4;                   // order of the runs allocated in the end, and whose fragmentation is shown
+
+typedef unsigned char Frame[1 << SHIFT];
+typedef Buddy<SHIFT, ORDERS> Frame_Buddy;
+typedef Grouping_List<Frame> Frame_List;       // as MMU kept free frames before
+
+OStream cout;
+
+Frame arena[2][FRAMES + 1];                     // + 1 for alignment
+unsigned long map[FRAMES / 8];                  // far more than Frame_Buddy::map_size(FRAMES)
+Frame_Buddy buddy;
+Frame_List list;
+
+struct Run {
+    Frame * frames;
+    unsigned long n;
+};
+Run run[SLOTS];
+
+struct Cost {
+    Cost(): count(0), total(0), worst(0) {}
+
+    void add(TSC::Time_Stamp t) {
+        count++;
+        total += t;
+        if(t > worst)
+            worst = t;
+    }
+
+    void print(const char * what) {
+        cout << "  " << what << ": " << count << " calls, " << (count ? total / count : 0) << " cycles on average, " << worst << " at worst" << endl;
+    }
+
+    unsigned long count;
+    TSC::Time_Stamp total;
+    TSC::Time_Stamp worst;
+};
+
+// The same interface for both
+struct Buddy_Frames {
+    static const char * name() { return "Buddy"; }
+    static Frame * alloc(unsigned long n) { return reinterpret_cast<Frame *>(buddy.alloc(n)); }
+    static void free(Frame * f, unsigned long n) { buddy.free(f, n); }
+    static unsigned long grouped_size() { return buddy.grouped_size(); }
+
+    static void statistics() {
+        cout << "  free blocks of each order:";
+        for(unsigned int o = 0; o < ORDERS; o++)
+            cout << " " << buddy.blocks(o);
+        cout << endl;
+        cout << "  largest block: " << buddy.largest() << " frames, fragmentation for 2^" << ORDER << " frames: "
+             << buddy.fragmentation(ORDER) << "%" << endl;
+    }
+};
+
+struct List_Frames {
+    static const char * name() { return "Grouping list"; }
+
+    static Frame * alloc(unsigned long n) {
+        Frame_List::Element * e = list.search_decrementing(n);
+        return e ? e->object() + e->size() : 0;
+    }
+
+    static void free(Frame * f, unsigned long n) {
+        Frame_List::Element * e = new (f) Frame_List::Element(f, n);
+        Frame_List::Element * m1, * m2;
+        list.insert_merging(e, &m1, &m2);
+    }
+
+    static unsigned long grouped_size() { return list.grouped_size(); }
+
+    static void statistics() { cout << "  free runs: " << list.size() << endl; }
+};
+
+template<typename F>
+void stress(Frame * frames)
+{
+    cout << "\n" << F::name() << ":" << endl;
+
+    F::free(frames, FRAMES);
+
+    Cost allocs, frees;
+    unsigned long failed = 0;
+
+    // Random runs allocated and freed, until the free frames are well shuffled
+    Random::seed(1);
+    for(unsigned int i = 0; i < SLOTS; i++)
+        run[i].frames = 0;
+    for(unsigned int i = 0; i < OPERATIONS; i++) {
+        unsigned int n = static_cast<unsigned int>(Random::random()) % SLOTS;
+        if(run[n].frames) {
+            TSC::Time_Stamp t = TSC::time_stamp();
+            F::free(run[n].frames, run[n].n);
+            frees.add(TSC::time_stamp() - t);
+            run[n].frames = 0;
+        } else {
+            unsigned int r = static_cast<unsigned int>(Random::random());
+            run[n].n = 1 + ((r % 8) ? (r >> 3) % SMALL : (r >> 3) % LARGE);
+            TSC::Time_Stamp t = TSC::time_stamp();
+            run[n].frames = F::alloc(run[n].n);
+            allocs.add(TSC::time_stamp() - t);
+            if(!run[n].frames)
+                failed++;
+        }
+    }
+    allocs.print("alloc()");
+    cout << "  (" << failed << " failed)" << endl;
+    frees.print("free()");
+    cout << "  free: " << F::grouped_size() << " frames" << endl;
+    F::statistics();
+
+    // Runs of 2^ORDER frames on fragmented memory, as for segments and DMA buffers
+    Cost fragmented;
+    unsigned long got = 0;
+    for(unsigned int i = 0; i < SLOTS; i++) {
+        if(run[i].frames)
+            continue;
+        TSC::Time_Stamp t = TSC::time_stamp();
+        run[i].frames = F::alloc(1 << ORDER);
+        fragmented.add(TSC::time_stamp() - t);
+        if(!run[i].frames)
+            break;
+        run[i].n = 1 << ORDER;
+        got++;
+    }
+    cout << "  then, " << got << " runs of " << (1 << ORDER) << " frames:" << endl;
+    fragmented.print("alloc()");
+
+    for(unsigned int i = 0; i < SLOTS; i++)
+        if(run[i].frames)
+            F::free(run[i].frames, run[i].n);
+    cout << "  after freeing everything: " << F::grouped_size() << " frames" << endl;
+}
+
+int main()
+{
+    cout << "Buddy Allocator Test" << endl;
+
+    cout << "\nThis test runs the same " << OPERATIONS << " random allocations and frees of runs of frames (up to " << SLOTS
+         << " at once, mostly up to " << SMALL << " frames long and one in eight up to " << LARGE << ") on a buddy"
+         << " allocator and on a grouping list, as MMU used to keep free frames, over " << FRAMES << " frames each. Then,"
+         << " runs of " << (1 << ORDER) << " frames are taken until none is left." << endl;
+    cout << "The grouping list searches and merges through all its free runs, while the buddy allocator takes at most"
+         << " " << ORDERS << " steps to split or merge blocks." << endl;
+
+    Frame * frames[2];
+    for(unsigned int i = 0; i < 2; i++)
+        frames[i] = reinterpret_cast<Frame *>((reinterpret_cast<unsigned long>(arena[i]) + sizeof(Frame) - 1) & ~(sizeof(Frame) - 1));
+
+    buddy.map(map, reinterpret_cast<unsigned long>(frames[0]), FRAMES);
+    stress<Buddy_Frames>(frames[0]);
+
+    stress<List_Frames>(frames[1]);
+
+    cout << "\nI'm also done, bye!" << endl;
+
+    return 0;
+}
@@ -0,0 +1,139 @@
+// EPOS Coroutine Test Program
+
+#include <time.h>
+#include <coroutine.h>
+
+using namespace EPOS;
+
+const unsigned int CPUS = Traits<Machine>::CPUS;
+const unsigned int tickers = 1000;
+const unsigned int rounds = 10;       // per ticker
+const unsigned int volleys = 100;     // per player
+const unsigned int waiters = 16;
+const Milisecond gate = 50;           // opened after
+
+OStream cout;
+Chronometer chrono;
+
+// Periodic activities, which would take a thread, and a stack, each
+struct Ticker: public Coroutine
+{
+    void run() {
+        CO_BEGIN;
+        for(i = 0; i < rounds; i++) {
+            CO_WAIT_NEXT(period);
+            done++;
+        }
+        CO_END;
+    }
+
+    Microsecond period;
+    unsigned int i;
+    unsigned int done;
+};
+
+// Semaphores passed back and forth between coroutines on different CPUs
+struct Player: public Coroutine
+{
+    void run() {
+        CO_BEGIN;
+        for(i = 0; i < volleys; i++) {
+            CO_AWAIT(*mine);
+            hits++;
+            other->v();
+        }
+        CO_END;
+    }
+
+    Coroutine::Semaphore * mine;
+    Coroutine::Semaphore * other;
+    unsigned int i;
+    unsigned int hits;
+};
+
+// The waiters and the opener share a run loop, so checking the gate and awaiting it cannot be interleaved with opening it
+Coroutine::Condition opened;
+volatile bool open;
+volatile unsigned int passed;
+
+struct Waiter: public Coroutine
+{
+    void run() {
+        CO_BEGIN;
+        while(!open)
+            CO_AWAIT(opened);
+        passed++;
+        CO_END;
+    }
+};
+
+struct Opener: public Coroutine
+{
+    void run() {
+        CO_BEGIN;
+        CO_DELAY(gate * 1000);
+        open = true;
+        opened.broadcast();
+        CO_END;
+    }
+};
+
+Ticker ticker[tickers];
+Coroutine::Semaphore ping(1), pong(0);
+Player player[2];
+Waiter waiter[waiters];
+Opener opener;
+
+int main()
+{
+    cout << "Coroutine Test" << endl;
+
+    cout << "\nThis test runs " << tickers << " periodic coroutines of " << rounds << " rounds each, spread over " << CPUS
+         << " CPUs, with periods of 10 to 40 ms. Each takes " << sizeof(Ticker) << " bytes, against the "
+         << Traits<Application>::STACK_SIZE << "-byte stack a thread would take." << endl;
+    cout << "Meanwhile, two coroutines on different CPUs pass a pair of semaphores back and forth " << volleys
+         << " times, and " << waiters << " coroutines wait on a condition that is broadcast after " << gate << " ms." << endl;
+
+    chrono.start();
+
+    for(unsigned int i = 0; i < tickers; i++) {
+        ticker[i].period = (i % 4 + 1) * 10000;
+        ticker[i].start(i % CPUS);
+    }
+
+    player[0].mine = &ping;
+    player[0].other = &pong;
+    player[1].mine = &pong;
+    player[1].other = &ping;
+    for(unsigned int i = 0; i < 2; i++)
+        player[i].start(i % CPUS);
+
+    for(unsigned int i = 0; i < waiters; i++)
+        waiter[i].start(0);
+    opener.start(0);
+
+    for(unsigned int i = 0; i < CPUS; i++)
+        cout << "CPU " << i << " runs " << Coroutine::count(i) << " coroutines." << endl;
+
+    unsigned long done = 0;
+    for(unsigned int i = 0; i < tickers; i++) {
+        ticker[i].join();
+        done += ticker[i].done;
+    }
+    chrono.stop();
+    cout << "\nThe tickers woke up " << done << " times out of " << tickers * rounds << " in " << chrono.read() / 1000
+         << " ms (the slowest should take about " << rounds * 40 << " ms)." << endl;
+
+    for(unsigned int i = 0; i < 2; i++)
+        player[i].join();
+    cout << "The players hit " << player[0].hits << " and " << player[1].hits << " times out of " << volleys << "." << endl;
+
+    opener.join();
+    for(unsigned int i = 0; i < waiters; i++)
+        waiter[i].join();
+    cout << passed << " waiters out of " << waiters << " passed the gate." << endl;
+
+    cout << "I'm also done, bye!" << endl;
+
+    return 0;
+}
@@ -0,0 +1,185 @@
+#ifndef __traits_h
+#define __traits_h
+
+#include <system/config.h>
+
+__BEGIN_SYS
+
+// Build
+template<> struct Traits<Build>: public Traits_Tokens
+{
+    // Basic configuration
+    static const unsigned int SMOD = LIBRARY;
+    static const unsigned int ARCHITECTURE = IA32;
+    static const unsigned int MACHINE = PC;
+    static const unsigned int MODEL = Legacy_PC;
+    static const unsigned int CPUS = 4;
+    static const unsigned int NETWORKING = STANDALONE;
+    static const unsigned int EXPECTED_SIMULATION_TIME = 60; // s (0 => not simulated)
+
+    // Default flags
+    static const bool enabled = true;
+    static const bool monitored = true;
+    static const bool debugged = true;
+    static const bool hysterically_debugged = false;
+};
+
+
+// Utilities
+template<> struct Traits<Debug>: public Traits<Build>
+{
+    static const bool error   = true;
+    static const bool warning = true;
+    static const bool info    = false;
+    static const bool trace   = false;
+};
+
+template<> struct Traits<Lists>: public Traits<Build>
+{
+    static const bool debugged = hysterically_debugged;
+};
+
+template<> struct Traits<Spin>: public Traits<Build>
+{
+    static const bool debugged = hysterically_debugged;
+};
+
+template<> struct Traits<Heaps>: public Traits<Build>
+{
+    static const bool debugged = hysterically_debugged;
+    enum {FIRST_FIT, TLSF};
+    static const unsigned int ALLOCATOR = FIRST_FIT;  // TLSF: O(1) alloc() and free(), for bounded latency
+    static const unsigned int MAGAZINE = 16;           // blocks of each small size each CPU keeps in front of the heap (multicore only, 0 disables)
+    static const unsigned int POOLED = 8;              // Alarms, Semaphores and Segments each CPU keeps for reuse (0 disables)
+};
+
+template<> struct Traits<Observers>: public Traits<Build>
+{
+    // Some observed objects are created before initializing the Display
+    // Enabling debug may cause trouble in some Machines
+    static const bool debugged = false;
+};
+
+
+// System Parts (mostly to fine control debugging)
+template<> struct Traits<Boot>: public Traits<Build>
+{
+};
+
+template<> struct Traits<Setup>: public Traits<Build>
+{
+};
+
+template<> struct Traits<Init>: public Traits<Build>
+{
+};
+
+template<> struct Traits<Framework>: public Traits<Build>
+{
+};
+
+template<> struct Traits<Aspect>: public Traits<Build>
+{
+    static const bool debugged = hysterically_debugged;
+};
+
+
+__END_SYS
+
+// Mediators
+#include __ARCHITECTURE_TRAITS_H
+#include __MACHINE_TRAITS_H
+
+__BEGIN_SYS
+
+
+// API Components
+template<> struct Traits<Application>: public Traits<Build>
+{
+    static const unsigned int STACK_SIZE = Traits<Machine>::STACK_SIZE;
+    static const unsigned int HEAP_SIZE = Traits<Machine>::HEAP_SIZE;
+    static const unsigned int MAX_THREADS = Traits<Machine>::MAX_THREADS;
+};
+
+template<> struct Traits<System>: public Traits<Build>
+{
+    static const bool multithread = (Traits<Application>::MAX_THREADS > 1) || (CPUS > 1);
+    static const bool multicore = multithread && (CPUS > 1);
+    static const bool multiheap = Traits<Scratchpad>::enabled;
+
+    static const unsigned long LIFE_SPAN = 1 * YEAR; // s
+    static const unsigned int DUTY_CYCLE = 1000000; // ppm
+
+    static const bool reboot = true;
+
+    static const unsigned int STACK_SIZE = Traits<Machine>::STACK_SIZE;
+    static const unsigned int HEAP_SIZE = (Traits<Application>::MAX_THREADS + Traits<Build>::CPUS) * Traits<Application>::STACK_SIZE;
+};
+
+template<> struct Traits<Thread>: public Traits<Build>
+{
+    static const bool enabled = Traits<System>::multithread;
+    static const bool smp = Traits<System>::multicore;
+    static const bool trace_idle = hysterically_debugged;
+    static const bool simulate_capacity = false;
+    static const int priority_inversion_protocol = INHERITANCE;
+
+    typedef GEDF Criterion;
+    static const unsigned int QUANTUM = 10000; // us
+    static const unsigned int CACHED = 2; // stacks and Thread objects each CPU keeps ready (see Pool)
+};
+
+template<> struct Traits<Scheduler<Thread>>: public Traits<Build>
+{
+    static const bool debugged = Traits<Thread>::trace_idle || hysterically_debugged;
+};
+
+template<> struct Traits<Synchronizer>: public Traits<Build>
+{
+    static const bool enabled = Traits<System>::multithread;
+};
+
+template<> struct Traits<Alarm>: public Traits<Build>
+{
+    static const bool visible = hysterically_debugged;
+};
+
+template<> struct Traits<Profiler>: public Traits<Build>
+{
+    static const bool enabled = false;
+    static const unsigned int SAMPLES = 1024; // per CPU
+};
+
+template<> struct Traits<Governor>: public Traits<Build>
+{
+    static const bool enabled = false;
+    enum {PERFORMANCE, POWERSAVE, ONDEMAND, DEADLINE};
+    static const unsigned int POLICY = ONDEMAND;
+    static const unsigned int PERIOD = 10000;           // us between decisions on each CPU
+    static const unsigned int SMOOTHING = 2;            // the load is averaged as l = l - l / 2^SMOOTHING + sample / 2^SMOOTHING
+    static const unsigned int UP_THRESHOLD = 80;        // ONDEMAND: load (%) above which the CPU goes to max_clock()
+    static const unsigned int HYSTERESIS = 5;           // clocks are only lowered by more than this (% of max_clock())
+    static const unsigned int TRACE = 64;               // clock changes kept per CPU
+};
+
+template<> struct Traits<Executor>: public Traits<Build>
+{
+    static const bool enabled = false;
+    static const unsigned int WORKERS_PER_CPU = 1;
+    static const unsigned int DEQUE_SIZE = 64;          // submissions each worker (and each CPU's inbox) can hold, a power of 2
+    static const unsigned int STACK_SIZE = Traits<Application>::STACK_SIZE;
+};
+
+template<> struct Traits<Coroutine>: public Traits<Build>
+{
+    static const unsigned int RESOLUTION = 1000;        // us per tick of CO_DELAY() and CO_WAIT_NEXT()
+    static const unsigned int STACK_SIZE = Traits<Application>::STACK_SIZE; // of each CPU's run loop
+};
+
+template<> struct Traits<Address_Space>: public Traits<Build> {};
+
+template<> struct Traits<Segment>: public Traits<Build> {};
+
+__END_SYS
+
+#endif
@@ -0,0 +1,103 @@
+// EPOS Task Executor Test Program
+
+#include <time.h>
+#include <executor.h>
+#include <utility/geometry.h>
+
+using namespace EPOS;
+
+const unsigned int chunks = 32;
+const unsigned int iterations = 2000; // per chunk
+const unsigned int depth = 16;        // of the recursive Fibonacci
+const unsigned int cutoff = 8;        // below which it is computed serially
+
+typedef Point<long, 2> Point2;
+
+OStream cout;
+Chronometer chrono;
+
+Point2 p1(2131231, 123123), p2(2, 13123), p3(12312, 123123);
+
+struct Chunk {
+    unsigned int first;
+    Point2 result;
+};
+
+Chunk chunk[chunks];
+
+int trilaterate(void * arg)
+{
+    Chunk * c = reinterpret_cast<Chunk *>(arg);
+    Point2 p(0, 0);
+    for(unsigned int i = 0; i < iterations; i++)
+        p = p + Point2::trilaterate(p1, 123123 + c->first + i, p2, 123123, p3, 123123);
+    c->result = p;
+
+    return 0;
+}
+
+int fibonacci(unsigned int n)
+{
+    return (n < 2) ? n : fibonacci(n - 1) + fibonacci(n - 2);
+}
+
+// Each call above the cutoff forks one half and computes the other, so workers submit to their own deques
+int fork(void * arg)
+{
+    unsigned int n = reinterpret_cast<unsigned long>(arg);
+    if(n < cutoff)
+        return fibonacci(n);
+
+    Executor::Future half;
+    Executor::submit(&half, &fork, reinterpret_cast<void *>(n - 1));
+    int other = fork(reinterpret_cast<void *>(n - 2));
+
+    return half.wait() + other;
+}
+
+int main()
+{
+    cout << "Task Executor Test" << endl;
+
+    cout << "\nThis test fans " << chunks << " chunks of " << iterations << " trilaterations out to " << Executor::WORKERS
+         << " workers, more than the threads EPOS could create for them, and checks the result against a serial run." << endl;
+    cout << "It then computes Fibonacci(" << depth << ") recursively, forking at each level above " << cutoff << ", so workers"
+         << " submit work themselves and steal each other's." << endl;
+
+    for(unsigned int i = 0; i < chunks; i++)
+        chunk[i].first = i * iterations;
+
+    chrono.start();
+    Point2 serial(0, 0);
+    for(unsigned int i = 0; i < chunks; i++) {
+        trilaterate(&chunk[i]);
+        serial = serial + chunk[i].result;
+    }
+    chrono.stop();
+    cout << "\nSerial: " << serial << " in " << chrono.read() << " us" << endl;
+
+    chrono.reset();
+    chrono.start();
+    Executor::Future future[chunks];
+    for(unsigned int i = 0; i < chunks; i++)
+        Executor::submit(&future[i], &trilaterate, &chunk[i]);
+    Point2 parallel(0, 0);
+    for(unsigned int i = 0; i < chunks; i++) {
+        future[i].wait();
+        parallel = parallel + chunk[i].result;
+    }
+    chrono.stop();
+    cout << "Executor: " << parallel << " in " << chrono.read() << " us" << endl;
+    cout << "The results " << ((parallel == serial) ? "match." : "DO NOT match!") << endl;
+
+    Executor::Future root;
+    Executor::submit(&root, &fork, reinterpret_cast<void *>(depth));
+    int fib = root.wait();
+    cout << "\nFibonacci(" << depth << ") = " << fib << " (" << ((fib == fibonacci(depth)) ? "right" : "WRONG") << ")" << endl;
+
+    cout << "\nThe executor ran " << Executor::executed() << " submissions, " << Executor::stolen() << " of them stolen." << endl;
+
+    cout << "I'm also done, bye!" << endl;
+
+    return 0;
+}
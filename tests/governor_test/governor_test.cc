@@ -0,0 +1,85 @@
+// EPOS DVFS Governor Test Program
+
+#include <time.h>
+#include <real-time.h>
+#include <governor.h>
+
+using namespace EPOS;
+
+const unsigned int iterations = 20;
+const unsigned int threads = 2;
+const Milisecond period[threads] = {100, 50};
+const Milisecond wcet[threads]   = { 20,  5};
+const Milisecond pause = 200;
+
+int func(unsigned int n);
+void report(const char * phase);
+
+OStream cout;
+
+Periodic_Thread * thread[threads];
+
+int main()
+{
+    cout << "DVFS Governor Test" << endl;
+
+    cout << "\nThis test runs " << threads << " periodic threads under EDF with the DEADLINE governor:" << endl;
+    unsigned long long density = 0;
+    for(unsigned int i = 0; i < threads; i++) {
+        cout << "- Thread " << char('A' + i) << ": p=" << period[i] << "ms, c=" << wcet[i] << "ms;" << endl;
+        density += wcet[i] * 100 / period[i];
+    }
+    cout << "Their capacities take " << density << "% of the CPU at " << CPU::max_clock() << " Hz, so the clock should settle"
+         << " at the first step above that (the CPU modulates its clock in steps of 6.25%)." << endl;
+
+    report("Before");
+
+    for(unsigned int i = 0; i < threads; i++)
+        thread[i] = new Periodic_Thread(RTConf(period[i] * 1000, 0, wcet[i] * 1000, 0, iterations * period[0] / period[i]), &func, i);
+
+    Delay settle(pause * 1000);
+    report("DEADLINE");
+
+    for(unsigned int i = 0; i < threads; i++)
+        thread[i]->join();
+
+    cout << "\nWith the threads gone, the other policies are tried on an idle CPU:" << endl;
+
+    Governor::policy(Governor::PERFORMANCE);
+    Delay performance(pause * 1000);
+    report("PERFORMANCE");
+
+    Governor::policy(Governor::POWERSAVE);
+    Delay powersave(pause * 1000);
+    report("POWERSAVE");
+
+    Governor::policy(Governor::ONDEMAND);
+    Delay ondemand(pause * 1000);
+    report("ONDEMAND");
+
+    cout << "\nThe clock changes of each CPU are dumped when EPOS shuts down." << endl;
+
+    cout << "I'm also done, bye!" << endl;
+
+    return 0;
+}
+
+void report(const char * phase)
+{
+    cout << phase << ": clock=" << CPU::clock() << " Hz (" << CPU::clock() * 100 / CPU::max_clock() << "% of max), load="
+         << Governor::load(CPU::id()) << "%, changes=" << Governor::decisions(CPU::id()) << endl;
+}
+
+int func(unsigned int n)
+{
+    Chronometer chrono;
+
+    do {
+        chrono.reset();
+        chrono.start();
+        while(chrono.read() < wcet[n] * 1000 / 2); // half of the WCET, to stay clear of the deadlines
+        chrono.stop();
+    } while (Periodic_Thread::wait_next());
+
+    return 'A' + n;
+}
@@ -0,0 +1,209 @@
+// EPOS Heap Fragmentation Stress Test Program
+
+#include <time.h>
+#include <utility/heap.h>
+#include <utility/random.h>
+
+using namespace EPOS;
+
+const unsigned int ARENA = 256 * 1024;
+const unsigned int SLOTS = 512;           // blocks live at once, at most
+const unsigned int OPERATIONS = 50000;
+const unsigned int SMALL = 256;           // most blocks are up to this long
+const unsigned int LARGE = 8192;          // and one in eight up to this
+const unsigned int HOLES = 1024;          // blocks allocated and then freed every other, for the last phase
+
+OStream cout;
+
+char arena[3][ARENA];
+void * slot[SLOTS];
+void * hole[HOLES];
+
+struct Cost {
+    Cost(): count(0), total(0), worst(0) {}
+
+    void add(TSC::Time_Stamp t) {
+        count++;
+        total += t;
+        if(t > worst)
+            worst = t;
+    }
+
+    unsigned long count;
+    TSC::Time_Stamp total;
+    TSC::Time_Stamp worst;
+};
+
+// The heap as it was before boundary tags: a first-fit grouping list whose insertions walk the list to merge neighbors
+class Grouping_Heap: private Grouping_List<char>
+{
+private:
+    static const bool typed = Traits<System>::multiheap;
+
+public:
+    using Grouping_List<char>::size;
+    using Grouping_List<char>::grouped_size;
+
+    Grouping_Heap(void * addr, unsigned long bytes) { free(addr, bytes); }
+
+    void * alloc(unsigned long bytes) {
+        if(!bytes)
+            return 0;
+
+        if(!Traits<CPU>::unaligned_memory_access)
+            while((bytes % sizeof(void *)))
+                ++bytes;
+
+        if(typed)
+            bytes += sizeof(void *);
+        bytes += sizeof(long);
+        if(bytes < sizeof(Element))
+            bytes = sizeof(Element);
+
+        Element * e = search_decrementing(bytes);
+        if(!e)
+            return 0;
+
+        long * addr = reinterpret_cast<long *>(e->object() + e->size());
+        if(typed)
+            *addr++ = reinterpret_cast<long>(this);
+        *addr++ = bytes;
+
+        return addr;
+    }
+
+    void free(void * ptr, unsigned long bytes) {
+        if(ptr && (bytes >= sizeof(Element))) {
+            Element * e = new (ptr) Element(reinterpret_cast<char *>(ptr), bytes);
+            Element * m1, * m2;
+            insert_merging(e, &m1, &m2);
+        }
+    }
+
+    static void typed_free(void * ptr) {
+        long * addr = reinterpret_cast<long *>(ptr);
+        unsigned long bytes = *--addr;
+        Grouping_Heap * heap = reinterpret_cast<Grouping_Heap *>(*--addr);
+        heap->free(addr, bytes);
+    }
+
+    static void untyped_free(Grouping_Heap * heap, void * ptr) {
+        long * addr = reinterpret_cast<long *>(ptr);
+        unsigned long bytes = *--addr;
+        heap->free(addr, bytes);
+    }
+};
+
+template<typename H>
+void release(H * heap, void * ptr)
+{
+    if(Traits<System>::multiheap)
+        H::typed_free(ptr);
+    else
+        H::untyped_free(heap, ptr);
+}
+
+// The largest block the heap can still give, found by halving
+template<typename H>
+unsigned long largest(H * heap)
+{
+    unsigned long low = 0, high = heap->grouped_size();
+    while(low < high) {
+        unsigned long middle = (low + high + 1) / 2;
+        void * p = heap->alloc(middle);
+        if(p) {
+            release(heap, p);
+            low = middle;
+        } else
+            high = middle - 1;
+    }
+    return low;
+}
+
+template<typename H>
+void report(H * heap)
+{
+    unsigned long available = heap->grouped_size();
+    unsigned long max = largest(heap);
+    cout << "  free: " << available << " bytes in " << heap->size() << " blocks, the largest of " << max << " bytes (fragmentation "
+         << (available ? 100 - max * 100 / available : 0) << "%)" << endl;
+}
+
+template<typename H>
+void stress(const char * name, char * memory)
+{
+    cout << "\n" << name << ":" << endl;
+
+    H * heap = new (SYSTEM) H(memory, ARENA);
+    Cost allocs, frees;
+    unsigned long failed = 0;
+
+    // Random allocations and frees of mostly small blocks, until the heap is well shuffled
+    Random::seed(1);
+    for(unsigned int i = 0; i < SLOTS; i++)
+        slot[i] = 0;
+    for(unsigned int i = 0; i < OPERATIONS; i++) {
+        unsigned int n = static_cast<unsigned int>(Random::random()) % SLOTS;
+        if(slot[n]) {
+            TSC::Time_Stamp t = TSC::time_stamp();
+            release(heap, slot[n]);
+            frees.add(TSC::time_stamp() - t);
+            slot[n] = 0;
+        } else {
+            unsigned int r = static_cast<unsigned int>(Random::random());
+            unsigned long bytes = 1 + ((r % 8) ? (r >> 3) % SMALL : (r >> 3) % LARGE);
+            TSC::Time_Stamp t = TSC::time_stamp();
+            slot[n] = heap->alloc(bytes);
+            allocs.add(TSC::time_stamp() - t);
+            if(!slot[n])
+                failed++;
+        }
+    }
+    cout << "  alloc(): " << allocs.count << " calls, " << allocs.total / allocs.count << " cycles on average, " << allocs.worst
+         << " at worst (" << failed << " failed)" << endl;
+    cout << "  free(): " << frees.count << " calls, " << frees.total / frees.count << " cycles on average, " << frees.worst
+         << " at worst" << endl;
+    report(heap);
+
+    // Holes: small blocks, every other one freed, so free memory is scattered in pieces too small for larger requests
+    unsigned int holes = 0;
+    for(; holes < HOLES; holes++) {
+        hole[holes] = heap->alloc(32);
+        if(!hole[holes])
+            break;
+    }
+    for(unsigned int i = 0; i < holes; i += 2)
+        release(heap, hole[i]);
+    cout << "  after freeing every other of " << holes << " small blocks:" << endl;
+    report(heap);
+
+    for(unsigned int i = 1; i < holes; i += 2)
+        release(heap, hole[i]);
+    for(unsigned int i = 0; i < SLOTS; i++)
+        if(slot[i])
+            release(heap, slot[i]);
+    cout << "  after freeing everything:" << endl;
+    report(heap);
+
+    delete heap;
+}
+
+int main()
+{
+    cout << "Heap Fragmentation Stress Test" << endl;
+
+    cout << "\nThis test runs the same " << OPERATIONS << " random allocations and frees (up to " << SLOTS << " blocks at"
+         << " once, mostly up to " << SMALL << " bytes and one in eight up to " << LARGE << ") on each heap allocator, over "
+         << ARENA << " bytes, and then frees every other of a run of small blocks to scatter free memory." << endl;
+    cout << "The previous heap walks its free list both to allocate and to merge freed blocks with their neighbors;"
+         << " the current one merges them in constant time, but still searches its free list to allocate, while TLSF"
+         << " does neither. Each should end with a single free block." << endl;
+
+    stress<Grouping_Heap>("Previous first-fit (Grouping_List)", arena[0]);
+    stress<Heap_Imp>("First-fit (Heap_Imp)", arena[1]);
+    stress<TLSF_Heap>("TLSF (TLSF_Heap)", arena[2]);
+
+    cout << "\nI'm also done, bye!" << endl;
+
+    return 0;
+}
@@ -0,0 +1,73 @@
+// EPOS Cache-Aware Migration Test Program
+
+#include <time.h>
+#include <real-time.h>
+
+using namespace EPOS;
+
+const unsigned int iterations = 100;
+const unsigned int threads = 2;
+const Milisecond period = 10;
+const Microsecond offset[threads] = {0, 1000}; // L is released while H runs, so it is the one left waiting
+const Microsecond work[threads] = {2000, 1000};
+const unsigned int footprint = 256 * 1024; // bytes H touches at each job
+const unsigned int line = Traits<CPU>::CACHE_LINE_SIZE;
+
+int func(unsigned int n);
+
+OStream cout;
+Chronometer chrono;
+
+Periodic_Thread * thread[threads];
+volatile char data[footprint];
+
+int main()
+{
+    cout << "Cache-Aware Migration Test" << endl;
+
+    cout << "\nThis test creates " << threads << " periodic threads that start on the same CPU, with another one idle:" << endl;
+    cout << "- Every " << period << "ms, thread H touches " << footprint / 1024 << "KB of data and then executes for " << work[0] / 1000 << "ms in all;" << endl;
+    cout << "- Every " << period << "ms, " << offset[1] / 1000 << "ms after H, thread L executes for " << work[1] / 1000 << "ms without touching any data." << endl;
+    cout << "Either one could go to the idle CPU, but moving H would leave its data behind, so L must be the one to go." << endl;
+
+    chrono.start();
+
+    // p,d,c,act,t
+    for(unsigned int i = 0; i < threads; i++)
+        thread[i] = new Periodic_Thread(RTConf(period * 1000, period * 1000, 0, offset[i], iterations), &func, i);
+
+    unsigned int start[threads];
+    for(unsigned int i = 0; i < threads; i++)
+        start[i] = thread[i]->criterion().queue();
+
+    for(unsigned int i = 0; i < threads; i++)
+        thread[i]->join();
+
+    chrono.stop();
+
+    for(unsigned int i = 0; i < threads; i++)
+        cout << "Thread " << (i ? 'L' : 'H') << " went from CPU " << start[i] << " to CPU " << thread[i]->criterion().queue()
+             << " with a footprint of " << thread[i]->footprint << " lines." << endl;
+
+    assert(start[0] == start[1]);
+    assert(thread[0]->footprint > thread[1]->footprint);
+    assert(thread[0]->criterion().queue() == start[0]);
+    assert(thread[1]->criterion().queue() != start[1]);
+
+    cout << "I'm also done, bye!" << endl;
+
+    return 0;
+}
+
+int func(unsigned int n)
+{
+    do {
+        unsigned long long release = chrono.read();
+        if(n == 0)
+            for(unsigned int i = 0; i < footprint; i += line)
+                data[i]++;
+        while(chrono.read() - release < work[n]);
+    } while(Periodic_Thread::wait_next());
+
+    return n ? 'L' : 'H';
+}
@@ -0,0 +1,88 @@
+// EPOS Budget Enforcement Test Program
+
+#include <time.h>
+#include <real-time.h>
+
+using namespace EPOS;
+
+const Milisecond duration = 2000;
+const unsigned int threads = 4;
+const Milisecond period[threads] = {100, 50, 200, 400};
+const Milisecond wcet[threads]   = { 10,  5,  20, 100};
+const Milisecond work[threads]   = { 30, 15,  40, 100}; // A, B and C overrun their capacities
+const Thread::Criterion::Overrun policy[threads] = {Thread::Criterion::SUSPEND, Thread::Criterion::DEMOTE, Thread::Criterion::NOTIFY, Thread::Criterion::IGNORE};
+
+int func(unsigned int n);
+void overrun();
+
+OStream cout;
+Chronometer chrono;
+
+Periodic_Thread * thread[threads];
+volatile unsigned int overruns;
+volatile unsigned int late[threads];
+volatile unsigned int suspended; // times D ran while A was suspended for overrunning
+volatile unsigned int demoted;   // times D ran while B was demoted for overrunning
+
+int main()
+{
+    cout << "Budget Enforcement Test" << endl;
+
+    cout << "\nThis test creates " << threads << " periodic threads under RM, three of which try to run longer than their capacities:" << endl;
+    cout << "- Every " << period[0] << "ms, thread A tries to execute for " << work[0] << "ms, but its capacity is " << wcet[0] << "ms and it is suspended until its next release when it overruns;" << endl;
+    cout << "- Every " << period[1] << "ms, thread B tries to execute for " << work[1] << "ms, but its capacity is " << wcet[1] << "ms and it is demoted to background priority until its next release when it overruns;" << endl;
+    cout << "- Every " << period[2] << "ms, thread C tries to execute for " << work[2] << "ms, but its capacity is " << wcet[2] << "ms and an overrun handler is invoked when it overruns;" << endl;
+    cout << "- Every " << period[3] << "ms, thread D executes for " << work[3] << "ms, within its capacity, and watches A and B." << endl;
+    cout << "D has the lowest priority, so it can only run while A is suspended or B is demoted if enforcement works. D must never be late." << endl;
+
+    chrono.start();
+
+    // p,d,c,act,t,s,ss,af,o,h
+    for(unsigned int i = 0; i < threads; i++)
+        thread[i] = new Periodic_Thread(RTConf(period[i] * 1000, 0, wcet[i] * 1000, 0, duration / period[i], Thread::READY, Traits<Application>::STACK_SIZE, Thread::ANY_CPU, policy[i], &overrun), &func, i);
+
+    for(unsigned int i = 0; i < threads; i++)
+        thread[i]->join();
+
+    chrono.stop();
+
+    for(unsigned int i = 0; i < threads; i++)
+        cout << "Thread " << char('A' + i) << " finished " << thread[i]->statistics().jobs_finished << " jobs, " << late[i] << " of them after their deadlines." << endl;
+    cout << "D ran " << suspended << " times while A was suspended and " << demoted << " times while B was demoted." << endl;
+    cout << "The overrun handler was invoked " << overruns << " times." << endl;
+
+    assert(suspended > 0);
+    assert(demoted > 0);
+    assert(overruns > 0);
+    assert(late[3] == 0);
+
+    cout << "I'm also done, bye!" << endl;
+
+    return 0;
+}
+
+void overrun()
+{
+    overruns++;
+}
+
+int func(unsigned int n)
+{
+    unsigned long long release = chrono.read();
+
+    do {
+        while(chrono.read() - release < work[n] * 1000) {
+            if(n == 3) {
+                if(thread[0]->criterion().overran() && (thread[0]->state() == Thread::SUSPENDED))
+                    suspended++;
+                if(thread[1]->criterion().overran() && (int(thread[1]->priority()) == Thread::Criterion::APERIODIC))
+                    demoted++;
+            }
+        }
+        if(chrono.read() - release > period[n] * 1000)
+            late[n]++;
+        release += period[n] * 1000;
+    } while (Periodic_Thread::wait_next());
+
+    return 'A' + n;
+}
@@ -0,0 +1,90 @@
+// EPOS Per-Thread PMU Counters Test Program
+
+#include <time.h>
+#include <process.h>
+
+using namespace EPOS;
+
+const unsigned int iterations = 50;
+const unsigned int threads = 2;
+const unsigned int work[threads] = {1000000, 2000000}; // B executes twice as many instructions as A
+
+// B counts branches and last-level cache hits instead of the default branch mispredictions and last-level cache misses
+const PMU::Event events[PMU::CHANNELS] = {0, 1, 2, PMU_Event::BRANCHES, PMU_Event::L3_CACHE_HITS, PMU::UNUSED, PMU::UNUSED};
+
+// B also counts more events than there are channels left (5 and 6), so they take turns at each time slice
+const PMU::Event multiplexed[] = {PMU_Event::LOAD_INSTRUCTIONS_RETIRED, PMU_Event::STORE_INSTRUCTIONS_RETIRED, PMU_Event::CONDITIONAL_BRANCHES,
+                                  PMU_Event::L1_CACHE_HITS, PMU_Event::L2_CACHE_HITS, PMU_Event::L1_INSTRUCTION_CACHE_MISSES, PMU::UNUSED};
+const char * names[] = {"loads", "stores", "conditional branches", "L1 hits", "L2 hits", "L1I misses"};
+
+int func(unsigned int n);
+bool close(PMU::Count count, PMU::Count expected, unsigned int tolerance);
+
+OStream cout;
+
+Thread * thread[threads];
+volatile unsigned int sink;
+
+int main()
+{
+    cout << "Per-Thread PMU Counters Test" << endl;
+
+    cout << "\nThis test creates " << threads << " threads that take turns on the CPU:" << endl;
+    cout << "- Thread A runs a loop of " << work[0] << " iterations between yields, counting the default events;" << endl;
+    cout << "- Thread B runs a loop of " << work[1] << " iterations between yields, counting branches and last-level cache hits on channels 3 and 4,"
+         << " plus " << sizeof(names) / sizeof(names[0]) << " more events multiplexed on channels 5 and 6." << endl;
+    cout << "Each thread only sees what it executed itself, so B must retire about twice as many instructions as A." << endl;
+    cout << "B's loop does one load and one store per iteration, so their estimates should be close to its number of iterations." << endl;
+
+    // All events above must be in this PMU's table, or the Context would silently leave them out
+    for(unsigned int c = PMU::FIXED; c < PMU::CHANNELS; c++)
+        assert((events[c] == PMU::UNUSED) || PMU::supported(events[c]));
+    for(unsigned int i = 0; multiplexed[i] != PMU::UNUSED; i++)
+        assert(PMU::supported(multiplexed[i]));
+
+    thread[0] = new Thread(&func, 0U);
+    thread[1] = new Thread(Thread::Configuration(Thread::READY, Thread::NORMAL, Traits<Application>::STACK_SIZE, Thread::ANY_CPU, events, multiplexed), &func, 1U);
+
+    for(unsigned int i = 0; i < threads; i++)
+        thread[i]->join();
+
+    for(unsigned int i = 0; i < threads; i++) {
+        cout << "Thread " << char('A' + i) << ":";
+        for(unsigned int c = 0; c < PMU::CHANNELS; c++)
+            cout << " " << c << "=" << thread[i]->pmu(c);
+        cout << endl;
+    }
+    for(unsigned int i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+        cout << "Thread B: ~" << thread[1]->pmu_estimate(i) << " " << names[i] << endl;
+    cout << "MAIN: instructions=" << Thread::self()->pmu(2) << endl;
+
+    // Counts include the few instructions spent yielding and the interrupts taken while each thread ran, hence the tolerances
+    assert(close(thread[1]->pmu(2), 2 * thread[0]->pmu(2), 25));
+    assert(thread[1]->pmu(3) >= iterations * work[1]);
+    assert(close(thread[1]->pmu_estimate(0), iterations * work[1], 50));
+    assert(close(thread[1]->pmu_estimate(1), iterations * work[1], 50));
+
+    cout << "I'm also done, bye!" << endl;
+
+    return 0;
+}
+
+int func(unsigned int n)
+{
+    for(unsigned int i = 0; i < iterations; i++) {
+        for(unsigned int j = 0; j < work[n]; j++)
+            sink += j;
+        Thread::yield();
+    }
+
+    return 'A' + n;
+}
+
+bool close(PMU::Count count, PMU::Count expected, unsigned int tolerance)
+{
+    PMU::Count margin = expected / 100 * tolerance;
+    bool ok = (count + margin >= expected) && (count <= expected + margin);
+    if(!ok)
+        cout << "Got " << count << " but expected " << expected << " +/- " << tolerance << "%!" << endl;
+    return ok;
+}
@@ -0,0 +1,118 @@
+// EPOS Object Pool Test Program
+
+#include <time.h>
+#include <synchronizer.h>
+#include <process.h>
+
+using namespace EPOS;
+
+const unsigned int ITERATIONS = 10000;
+const unsigned int THREADS = 100;
+
+OStream cout;
+
+struct Cost {
+    Cost(): total(0), worst(0) {}
+
+    void add(TSC::Time_Stamp t) {
+        total += t;
+        if(t > worst)
+            worst = t;
+    }
+
+    void print(const char * what, unsigned long count) {
+        cout << "  " << what << ": " << total / count << " cycles on average, " << worst << " at worst" << endl;
+    }
+
+    TSC::Time_Stamp total;
+    TSC::Time_Stamp worst;
+};
+
+int nothing() { return 0; }
+
+int main()
+{
+    cout << "Object Pool Test" << endl;
+
+    cout << "\nThis test creates and deletes " << ITERATIONS << " Semaphores and Alarms, and " << THREADS << " Threads, each"
+         << " reusing the storage of the one deleted before it, which comes from this CPU's pool instead of the heap. The"
+         << " same number of equally-sized blocks are then taken from and given back to the heap, for comparison." << endl;
+
+    // Reuse: the last object deleted is the next one created
+    Semaphore * s = new (SYSTEM) Semaphore;
+    void * first = s;
+    delete s;
+    s = new (SYSTEM) Semaphore;
+    cout << "\nA Semaphore deleted and created again " << ((s == first) ? "got its storage back" : "did NOT get its storage back!") << endl;
+    delete s;
+
+    Cost pooled, heap;
+
+    for(unsigned int i = 0; i < ITERATIONS; i++) {
+        TSC::Time_Stamp t = TSC::time_stamp();
+        Semaphore * s = new (SYSTEM) Semaphore;
+        delete s;
+        pooled.add(TSC::time_stamp() - t);
+
+        t = TSC::time_stamp();
+        char * b = new (SYSTEM) char[sizeof(Semaphore)];
+        delete [] b;
+        heap.add(TSC::time_stamp() - t);
+    }
+    cout << "\nSemaphore (" << sizeof(Semaphore) << " bytes):" << endl;
+    pooled.print("new and delete", ITERATIONS);
+    heap.print("heap alloc() and free()", ITERATIONS);
+
+    Handler * handler = 0;
+    pooled = Cost();
+    heap = Cost();
+    for(unsigned int i = 0; i < ITERATIONS; i++) {
+        TSC::Time_Stamp t = TSC::time_stamp();
+        Alarm * a = new (SYSTEM) Alarm(1000000, handler);
+        delete a;
+        pooled.add(TSC::time_stamp() - t);
+
+        t = TSC::time_stamp();
+        char * b = new (SYSTEM) char[sizeof(Alarm)];
+        delete [] b;
+        heap.add(TSC::time_stamp() - t);
+    }
+    cout << "\nAlarm (" << sizeof(Alarm) << " bytes, including its insertion into and removal from the alarm queue):" << endl;
+    pooled.print("new and delete", ITERATIONS);
+    heap.print("heap alloc() and free()", ITERATIONS);
+
+    pooled = Cost();
+    heap = Cost();
+    for(unsigned int i = 0; i < THREADS; i++) {
+        TSC::Time_Stamp t = TSC::time_stamp();
+        Thread * th = new (SYSTEM) Thread(Thread::Configuration(Thread::SUSPENDED), &nothing);
+        delete th;
+        pooled.add(TSC::time_stamp() - t);
+
+        t = TSC::time_stamp();
+        char * b = new (SYSTEM) char[sizeof(Thread)];
+        char * stack = new (SYSTEM) char[Traits<Application>::STACK_SIZE];
+        delete [] stack;
+        delete [] b;
+        heap.add(TSC::time_stamp() - t);
+    }
+    cout << "\nThread (" << sizeof(Thread) << " bytes, plus a " << Traits<Application>::STACK_SIZE << "-byte stack,"
+         << " including its insertion into and removal from the scheduler):" << endl;
+    pooled.print("new and delete", THREADS);
+    heap.print("heap alloc() and free() of the object and the stack", THREADS);
+
+    // Poisoning: writes through a dangling pointer are reported when the storage is handed out again
+    if(Traits<Heaps>::debugged) {
+        cout << "\nWriting to a deleted Semaphore, which should be reported when the next one is created:" << endl;
+        s = new (SYSTEM) Semaphore;
+        volatile long * dangling = reinterpret_cast<volatile long *>(s);
+        delete s;
+        *dangling = 0;
+        s = new (SYSTEM) Semaphore;
+        delete s;
+    }
+
+    cout << "\nI'm also done, bye!" << endl;
+
+    return 0;
+}
@@ -0,0 +1,77 @@
+// EPOS Sampling Profiler Test Program
+
+#include <process.h>
+#include <profiler.h>
+
+using namespace EPOS;
+
+const unsigned int iterations = 200;
+const unsigned int size = 256 * 1024; // larger than the last-level cache of most hosts, in words
+const unsigned int stride = 16;       // one cache line per access
+
+const PMU::Count cycles_period = 1000000;
+const PMU::Count misses_period = 1000;
+
+int compute();
+int touch();
+
+OStream cout;
+
+volatile unsigned int sink;
+unsigned int * buffer;
+
+int main()
+{
+    cout << "Sampling Profiler Test" << endl;
+
+    cout << "\nThis test samples unhalted cycles every " << cycles_period << " cycles on channel " << Profiler::CHANNEL
+         << " and last-level cache misses every " << misses_period << " misses on channel " << Profiler::CHANNEL - 1 << ", while two threads run:" << endl;
+    cout << "- Thread A computes in a tight loop, so it should get most cycle samples;" << endl;
+    cout << "- Thread B walks a large buffer one cache line at a time, so it should get most miss samples." << endl;
+    cout << "The samples are dumped when EPOS shuts down; run \"eposprof <elf> <log>\" on the host for a flat profile." << endl;
+
+    buffer = new unsigned int[size];
+
+    bool cycles = Profiler::start(PMU_Event::UNHALTED_CYCLES, cycles_period);
+    bool misses = Profiler::start(PMU_Event::L3_CACHE_MISSES, misses_period, Profiler::CHANNEL - 1);
+    assert(cycles && misses);
+
+    Thread * a = new Thread(&compute);
+    Thread * b = new Thread(&touch);
+
+    a->join();
+    b->join();
+
+    unsigned long samples = 0;
+    for(unsigned int cpu = 0; cpu < Traits<Machine>::CPUS; cpu++) {
+        cout << "CPU " << cpu << " took " << Profiler::samples(cpu) << " samples." << endl;
+        samples += Profiler::samples(cpu);
+    }
+    assert(samples > 0);
+
+    delete a;
+    delete b;
+    delete [] buffer;
+
+    cout << "I'm also done, bye!" << endl;
+
+    return 0;
+}
+
+int compute()
+{
+    for(unsigned int i = 0; i < iterations; i++)
+        for(unsigned int j = 0; j < 100000; j++)
+            sink += j * i;
+
+    return 'A';
+}
+
+int touch()
+{
+    for(unsigned int i = 0; i < iterations; i++)
+        for(unsigned int j = 0; j < size; j += stride)
+            sink += buffer[j]++;
+
+    return 'B';
+}
@@ -0,0 +1,179 @@
+// EPOS Constant Bandwidth Server Scheduler Test Program
+
+#include <time.h>
+#include <real-time.h>
+#include <utility/geometry.h>
+
+using namespace EPOS;
+
+const unsigned int iterations = 50;
+const Milisecond period_a = 100;
+const Milisecond period_b = 50;
+const Milisecond wcet_a = 40;
+const Milisecond wcet_b = 10;
+const Milisecond budget_s = 20;
+const Milisecond period_s = 100;
+const Milisecond work_s = 1000;
+const Microsecond budget_t = 400;  // less than a tick
+const Microsecond period_t = 10000;
+const Milisecond work_t = 20;
+
+int func_a();
+int func_b();
+int func_s();
+int func_t();
+
+OStream cout;
+Chronometer chrono;
+
+Periodic_Thread * thread_a;
+Periodic_Thread * thread_b;
+Thread * thread_s;
+Thread * thread_t;
+
+Point<long, 2> p, p1(2131231, 123123), p2(2, 13123), p3(12312, 123123);
+
+unsigned long base_loop_count;
+
+void callibrate()
+{
+    chrono.start();
+    Microsecond end = chrono.read() + Microsecond(1000000UL);
+
+    base_loop_count = 0;
+
+    while(chrono.read() < end) {
+        p = p + Point<long, 2>::trilaterate(p1, 123123, p2, 123123, p3, 123123);
+        base_loop_count++;
+    }
+
+    chrono.stop();
+
+    base_loop_count /= 1000;
+}
+
+inline void exec(char c, Milisecond time = 0)
+{
+    Milisecond elapsed = chrono.read() / 1000;
+    Milisecond end = elapsed + time;
+
+    cout << "\n" << elapsed << " " << c
+         << " [A={i=" << thread_a->priority() << ",c=" << thread_a->statistics().job_utilization << "}"
+         <<  " B={i=" << thread_b->priority() << ",c=" << thread_b->statistics().job_utilization << "}"
+         <<  " S={i=" << thread_s->priority() << ",q=" << thread_s->criterion().budget() << "}]";
+
+    while(elapsed < end) {
+        for(unsigned long i = 0; i < time; i++)
+            for(unsigned long j = 0; j < base_loop_count; j++) {
+                p = p + Point<long, 2>::trilaterate(p1, 123123, p2, 123123, p3, 123123);
+        }
+        elapsed = chrono.read() / 1000;
+        cout << "\n" << elapsed << " " << c
+             << " [A={i=" << thread_a->priority() << ",c=" << thread_a->statistics().job_utilization << "}"
+             <<  " B={i=" << thread_b->priority() << ",c=" << thread_b->statistics().job_utilization << "}"
+             <<  " S={i=" << thread_s->priority() << ",q=" << thread_s->criterion().budget() << "}]";
+    }
+}
+
+
+int main()
+{
+    cout << "Constant Bandwidth Server Scheduler Test" << endl;
+
+    cout << "\nThis test consists in creating two periodic threads and an aperiodic one served by a CBS as follows:" << endl;
+    cout << "- Every " << period_a << "ms, thread A executes \"a\" for " << wcet_a << "ms;" << endl;
+    cout << "- Every " << period_b << "ms, thread B executes \"b\" for " << wcet_b << "ms;" << endl;
+    cout << "- Thread S executes \"s\" for " << work_s << "ms in a row, but its server grants it only " << budget_s << "ms every " << period_s << "ms." << endl;
+    cout << "- Thread T executes \"t\" for " << work_t << "ms in a row, but its server grants it only " << budget_t << "us (less than a tick) every " << period_t << "us." << endl;
+    cout << "S's deadline (i) is postponed each time its budget (q) runs out, so A and B keep meeting their deadlines while S uses the remaining CPU time." << endl;
+
+    cout << "\nCallibrating the duration of the base execution loop: ";
+    callibrate();
+    cout << base_loop_count << " iterations per ms!" << endl;
+
+    cout << "\nThreads will now be created and I'll wait for them to finish..." << endl;
+
+    // p,d,c,act,t
+    thread_a = new Periodic_Thread(RTConf(period_a * 1000, 0, wcet_a * 1000, 0, iterations), &func_a);
+    thread_b = new Periodic_Thread(RTConf(period_b * 1000, 0, wcet_b * 1000, 0, iterations * period_a / period_b), &func_b);
+    thread_s = new Thread(Thread::Configuration(Thread::READY, CBS(CBS::Server(budget_s * 1000, period_s * 1000))), &func_s);
+    thread_t = new Thread(Thread::Configuration(Thread::READY, CBS(CBS::Server(budget_t, period_t))), &func_t);
+
+    // A budget shorter than a tick is rounded up to one tick instead of down to none
+    assert(thread_t->criterion().server() && (thread_t->criterion().budget() > 0));
+
+    exec('M');
+
+    chrono.reset();
+    chrono.start();
+
+    int status_a = thread_a->join();
+    int status_b = thread_b->join();
+    int status_s = thread_s->join();
+    int status_t = thread_t->join();
+
+    chrono.stop();
+
+    exec('M');
+
+    cout << "\n... done!" << endl;
+    cout << "\n\nThread A exited with status \"" << char(status_a)
+         << "\", thread B exited with status \"" << char(status_b)
+         << "\", thread S exited with status \"" << char(status_s)
+         << "\" and thread T exited with status \"" << char(status_t) << "." << endl;
+    assert((status_a == 'A') && (status_b == 'B') && (status_s == 'S') && (status_t == 'T'));
+
+    cout << "\nThe estimated time to run the test was "
+         << period_a * iterations
+         << " ms. The measured time was " << chrono.read() / 1000 <<" ms!" << endl;
+
+    cout << "I'm also done, bye!" << endl;
+
+    return 0;
+}
+
+int func_a()
+{
+    exec('A');
+
+    do {
+        exec('a', wcet_a);
+    } while (Periodic_Thread::wait_next());
+
+    exec('A');
+
+    return 'A';
+}
+
+int func_b()
+{
+    exec('B');
+
+    do {
+        exec('b', wcet_b);
+    } while (Periodic_Thread::wait_next());
+
+    exec('B');
+
+    return 'B';
+}
+
+int func_s()
+{
+    exec('S');
+
+    for(unsigned int i = 0; i < work_s / 10; i++)
+        exec('s', 10);
+
+    exec('S');
+
+    return 'S';
+}
+
+int func_t()
+{
+    for(unsigned int i = 0; i < work_t; i++)
+        exec('t', 1);
+
+    return 'T';
+}
@@ -0,0 +1,122 @@
+// EPOS Global EDF Scheduler Test Program
+
+#include <time.h>
+#include <real-time.h>
+#include <utility/geometry.h>
+
+using namespace EPOS;
+
+const unsigned int iterations = 100;
+const unsigned int threads = 6;
+const Milisecond period[threads] = {100, 80, 60, 50, 40, 100};
+const Milisecond wcet[threads]   = { 50, 40, 30, 20, 10,  30};
+
+int func(unsigned int n);
+
+OStream cout;
+Chronometer chrono;
+
+Periodic_Thread * thread[threads];
+
+Point<long, 2> p, p1(2131231, 123123), p2(2, 13123), p3(12312, 123123);
+
+unsigned long base_loop_count;
+
+void callibrate()
+{
+    chrono.start();
+    Microsecond end = chrono.read() + Microsecond(1000000UL);
+
+    base_loop_count = 0;
+
+    while(chrono.read() < end) {
+        p = p + Point<long, 2>::trilaterate(p1, 123123, p2, 123123, p3, 123123);
+        base_loop_count++;
+    }
+
+    chrono.stop();
+
+    base_loop_count /= 1000;
+}
+
+inline void exec(char c, Milisecond time = 0)
+{
+    Milisecond elapsed = chrono.read() / 1000;
+    Milisecond end = elapsed + time;
+
+    cout << "\n" << elapsed << " " << c << "@" << CPU::id();
+
+    while(elapsed < end) {
+        for(unsigned long i = 0; i < time; i++)
+            for(unsigned long j = 0; j < base_loop_count; j++) {
+                p = p + Point<long, 2>::trilaterate(p1, 123123, p2, 123123, p3, 123123);
+        }
+        elapsed = chrono.read() / 1000;
+        cout << "\n" << elapsed << " " << c << "@" << CPU::id()
+             << " [i=" << Thread::self()->priority() << ",c=" << Thread::self()->statistics().job_utilization << "]";
+    }
+}
+
+
+int main()
+{
+    cout << "Global EDF Scheduler Test" << endl;
+
+    cout << "\nThis test consists in creating " << threads << " periodic threads that share a single deadline-ordered queue among the "
+         << CPU::cores() << " CPUs, with a total utilization above that of a single CPU, as follows:" << endl;
+    for(unsigned int i = 0; i < threads; i++)
+        cout << "- Every " << period[i] << "ms, thread " << char('A' + i) << " executes \"" << char('a' + i) << "\" for " << wcet[i] << "ms;" << endl;
+    cout << "A job released with an earlier deadline than those running preempts the CPU running the latest one, so jobs migrate among CPUs (the CPU is shown after each \"@\")." << endl;
+
+    cout << "\nCallibrating the duration of the base execution loop: ";
+    callibrate();
+    cout << base_loop_count << " iterations per ms!" << endl;
+
+    cout << "\nThreads will now be created and I'll wait for them to finish..." << endl;
+
+    // p,d,c,act,t
+    for(unsigned int i = 0; i < threads; i++)
+        thread[i] = new Periodic_Thread(RTConf(period[i] * 1000, 0, wcet[i] * 1000, 0, iterations), &func, i);
+
+    exec('M');
+
+    chrono.reset();
+    chrono.start();
+
+    int status[threads];
+    for(unsigned int i = 0; i < threads; i++)
+        status[i] = thread[i]->join();
+
+    chrono.stop();
+
+    exec('M');
+
+    cout << "\n... done!" << endl;
+    for(unsigned int i = 0; i < threads; i++)
+        cout << "\nThread " << char('A' + i) << " exited with status \"" << char(status[i]) << "\" after " << thread[i]->statistics().jobs_finished << " jobs.";
+
+    Milisecond max = 0;
+    for(unsigned int i = 0; i < threads; i++)
+        max = Math::max(max, period[i]);
+
+    cout << "\n\nThe estimated time to run the test was "
+         << max * iterations
+         << " ms. The measured time was " << chrono.read() / 1000 <<" ms!" << endl;
+
+    cout << "I'm also done, bye!" << endl;
+
+    return 0;
+}
+
+int func(unsigned int n)
+{
+    exec('A' + n);
+
+    do {
+        exec('a' + n, wcet[n]);
+    } while (Periodic_Thread::wait_next());
+
+    exec('A' + n);
+
+    return 'A' + n;
+}